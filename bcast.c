@@ -0,0 +1,490 @@
+/*
+ * Name:	bcast.c
+ *
+ * Purpose:     This file contains the routines which send the screen to
+ *		spectators over a UNIX socket. See bcast.h for the idea.
+ *
+ *		The display thread only ever swaps in a new frame and
+ *		writes a byte down a pipe, so it never waits on a
+ *		spectator. Everything else is done by one server thread,
+ *		which polls the listening socket, the pipe and all of the
+ *		spectators. Each spectator keeps a reference to the frame it
+ *		is sending and how far through it is; the bytes themselves
+ *		are never copied, only handed to send(). A spectator whose
+ *		socket is full is left until poll() says it can take more,
+ *		and when it has finished its frame it goes straight to the
+ *		newest one, skipping any it missed.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	Flush the last frame when closing, and
+ *				bcast_abort() for the ^C handler
+ *		10-19-26	Spectators don't echo what is typed
+ *
+ */
+
+#define	_GNU_SOURCE		/* for accept4 and pipe2 */
+#include "bcast.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+/* sent once to each new spectator, to clear the screen */
+static	const char	hello[] = "\033[H\033[2J";
+
+/* one spectator */
+typedef struct client {
+	int	fd;		/* its socket				*/
+	size_t	hello;		/* bytes of hello[] sent so far		*/
+	frame	*f;		/* frame being sent, or NULL		*/
+	size_t	off;		/* bytes of it sent so far		*/
+	int	busy;		/* socket was full, wait for POLLOUT	*/
+} client;
+
+/* everything the display shares with the server thread */
+static struct {
+	pthread_mutex_t	lock;	/* protects latest			*/
+	frame	*latest;	/* newest frame, holds one reference	*/
+	int	active;		/* bcast_open() succeeded		*/
+	int	quit;		/* tells the server thread to stop	*/
+	int	listen_fd;	/* the socket spectators connect to	*/
+	int	wake[2];	/* pipe that wakes the server thread	*/
+	pthread_t thread;
+	struct timespec last;	/* when the last frame was due		*/
+	char	path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+} bc = { PTHREAD_MUTEX_INITIALIZER };
+
+/* ==================================================================== */
+
+/* frame_put() drops a reference to f, and frees it if it was the last */
+
+static void frame_put(frame *f)
+{
+	if(f && __atomic_sub_fetch(&f->refs, 1, __ATOMIC_ACQ_REL) == 0)
+		free(f);
+}
+
+/* frame_get() returns the newest frame with a reference added, or NULL */
+
+static frame *frame_get(void)
+{
+	frame	*f;
+
+	pthread_mutex_lock(&bc.lock);
+	if((f = bc.latest))
+		__atomic_add_fetch(&f->refs, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&bc.lock);
+	return(f);
+}
+
+/* ==================================================================== */
+
+/*  send_client() sends as much to a spectator as its socket will take.
+ *  Returns 0 when it is up to date, 1 if the socket is full, or -1 if
+ *  the spectator has gone away.
+ */
+
+static int send_client(client *c)
+{
+	const char *p;
+	size_t	len;
+	ssize_t	n;
+	frame	*f;
+
+	for(;;)
+	{
+		if(c->hello < sizeof(hello)-1)
+		{
+			p = hello + c->hello;
+			len = sizeof(hello)-1 - c->hello;
+		}
+		else
+		{
+			if(!c->f || c->off == c->f->len)
+			{
+				/* done with this one, skip to the newest */
+				f = frame_get();
+				if(f == c->f)
+				{
+					frame_put(f);
+					return(0);
+				}
+				frame_put(c->f);
+				c->f = f;
+				c->off = 0;
+				if(!f)
+					return(0);
+			}
+			p = c->f->data + c->off;
+			len = c->f->len - c->off;
+		}
+		n = send(c->fd, p, len, MSG_DONTWAIT|MSG_NOSIGNAL);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				return(1);
+			return(-1);
+		}
+		if(c->hello < sizeof(hello)-1)
+			c->hello += n;
+		else
+			c->off += n;
+	}
+}
+
+/* ==================================================================== */
+
+/*  server() is the server thread. It sleeps in poll() until a frame is
+ *  published, somebody connects, or a full socket has room again.
+ *
+ *  When told to quit it stops taking new spectators, but carries on
+ *  until everybody has the last frame, or until nobody has taken
+ *  anything for BCAST_LINGER mS.
+ */
+
+static void *server(void *arg)
+{
+	static	client	clients[BCAST_MAXCLIENTS];
+	static	struct pollfd pfd[BCAST_MAXCLIENTS+2];
+	int	nclients = 0;
+	int	quitting = 0;
+	int	busy;
+	int	i,j,fd,r;
+	char	junk[64];
+
+	for(;;)
+	{
+		pfd[0].fd = quitting ? -1 : bc.listen_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = bc.wake[0];
+		pfd[1].events = POLLIN;
+		for(i=0;i<nclients;i++)
+		{
+			/* hangups are always reported, even with no events */
+			pfd[i+2].fd = clients[i].fd;
+			pfd[i+2].events = clients[i].busy ? POLLOUT : 0;
+		}
+		r = poll(pfd, nclients+2, quitting ? BCAST_LINGER : -1);
+		if(r < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			perror("poll");
+			break;
+		}
+		if(r == 0)		/* only when quitting */
+			break;
+		if(__atomic_load_n(&bc.quit, __ATOMIC_ACQUIRE))
+			quitting = 1;
+		if(pfd[1].revents & POLLIN)
+			while(read(bc.wake[0], junk, sizeof(junk)) > 0)
+				;
+
+		/* catch everybody up, and drop the ones that have gone */
+		busy = 0;
+		for(i=j=0;i<nclients;i++)
+		{
+			r = -1;
+			if(!(pfd[i+2].revents & (POLLHUP|POLLERR|POLLNVAL)))
+				r = send_client(&clients[i]);
+			if(r < 0)
+			{
+				close(clients[i].fd);
+				frame_put(clients[i].f);
+				continue;
+			}
+			clients[i].busy = r;
+			busy |= r;
+			clients[j++] = clients[i];
+		}
+		nclients = j;
+
+		if(quitting)
+		{
+			if(!busy)
+				break;
+			continue;
+		}
+		if(!(pfd[0].revents & POLLIN))
+			continue;
+		while((fd = accept4(bc.listen_fd, NULL, NULL,
+			SOCK_NONBLOCK|SOCK_CLOEXEC)) >= 0)
+		{
+			if(nclients == BCAST_MAXCLIENTS)
+			{
+				close(fd);
+				continue;
+			}
+			clients[nclients].fd = fd;
+			clients[nclients].hello = 0;
+			clients[nclients].f = NULL;
+			clients[nclients].off = 0;
+			r = send_client(&clients[nclients]);
+			if(r < 0)
+			{
+				close(fd);
+				frame_put(clients[nclients].f);
+				continue;
+			}
+			clients[nclients++].busy = r;
+		}
+	}
+	for(i=0;i<nclients;i++)
+	{
+		close(clients[i].fd);
+		frame_put(clients[i].f);
+	}
+	return(arg);
+}
+
+/* ==================================================================== */
+
+/*  bcast_open() sets up the socket and starts the server thread. A
+ *  socket left behind by an earlier run is removed first, but nothing
+ *  else is.
+ */
+
+int bcast_open(const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	sigset_t all, old;
+
+	if(strlen(path) >= sizeof(addr.sun_path))
+	{
+		printf("Socket name %s is too long\n", path);
+		return(-1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if(lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+		unlink(path);
+
+	bc.listen_fd = socket(AF_UNIX, SOCK_STREAM|SOCK_NONBLOCK|SOCK_CLOEXEC, 0);
+	if(bc.listen_fd < 0)
+	{
+		perror("socket");
+		return(-1);
+	}
+	if(bind(bc.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(bc.listen_fd, 16) < 0)
+	{
+		perror(path);
+		close(bc.listen_fd);
+		return(-1);
+	}
+	if(pipe2(bc.wake, O_NONBLOCK|O_CLOEXEC) < 0)
+	{
+		perror("pipe");
+		close(bc.listen_fd);
+		unlink(path);
+		return(-1);
+	}
+	strcpy(bc.path, path);
+
+	/* signals like SIGWINCH belong to the display, not the server */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	if(pthread_create(&bc.thread, NULL, server, NULL) != 0)
+	{
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		printf("Can't start the broadcast thread\n");
+		close(bc.listen_fd);
+		close(bc.wake[0]);
+		close(bc.wake[1]);
+		unlink(path);
+		return(-1);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	bc.active = 1;
+	return(0);
+}
+
+/* ==================================================================== */
+
+int bcast_active(void)
+{
+	return(bc.active);
+}
+
+/*  bcast_due() is called after every refresh, so it only looks at the
+ *  clock. If a frame is due, the next one is due a frame time later.
+ */
+
+int bcast_due(void)
+{
+	struct timespec now;
+	long	ns;
+
+	if(!bc.active)
+		return(0);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ns = (now.tv_sec - bc.last.tv_sec) * 1000000000L +
+		(now.tv_nsec - bc.last.tv_nsec);
+	if(ns < 1000000000L / BCAST_FPS)
+		return(0);
+	bc.last = now;
+	return(1);
+}
+
+/* ==================================================================== */
+
+frame *bcast_alloc(size_t size)
+{
+	frame	*f;
+
+	if(!(f = malloc(sizeof(frame) + size)))
+		return(NULL);
+	f->refs = 1;
+	f->len = 0;
+	return(f);
+}
+
+/*  bcast_publish() swaps f in as the newest frame. The old one is freed
+ *  once the last spectator sending it has finished.
+ */
+
+void bcast_publish(frame *f)
+{
+	frame	*old;
+
+	if(!bc.active)
+	{
+		frame_put(f);
+		return;
+	}
+	pthread_mutex_lock(&bc.lock);
+	old = bc.latest;
+	bc.latest = f;
+	pthread_mutex_unlock(&bc.lock);
+	frame_put(old);
+	/* if the pipe is full the thread is awake already */
+	if(write(bc.wake[1], "", 1) < 0)
+		;
+}
+
+/* ==================================================================== */
+
+/*  bcast_close() is called once the last frame has been published. The
+ *  server thread sends it, and then we wait for the thread to finish.
+ */
+
+void bcast_close(void)
+{
+	if(!bc.active)
+		return;
+	bc.active = 0;
+	__atomic_store_n(&bc.quit, 1, __ATOMIC_RELEASE);
+	if(write(bc.wake[1], "", 1) < 0)
+		;
+	pthread_join(bc.thread, NULL);
+	close(bc.listen_fd);
+	close(bc.wake[0]);
+	close(bc.wake[1]);
+	unlink(bc.path);
+	frame_put(bc.latest);
+	bc.latest = NULL;
+}
+
+/*  bcast_abort() is for the ^C handler, which may have interrupted
+ *  bcast_publish() with the lock held, so it mustn't wait for the
+ *  server thread. It only removes the socket; the spectators see the
+ *  end of the broadcast when we exit.
+ */
+
+void bcast_abort(void)
+{
+	if(bc.active)
+		unlink(bc.path);
+}
+
+/* ==================================================================== */
+
+/*  bcast_watch() is the spectator's end. The frames are plain terminal
+ *  output, so all it has to do is copy them, and put the cursor back
+ *  afterwards. ^C stops it. Nothing is read from the keyboard, so echo
+ *  and line editing are turned off while it runs, or keys typed would
+ *  be drawn over the screen, and anything typed is thrown away when it
+ *  puts the terminal back.
+ */
+
+static	volatile sig_atomic_t	stop;
+
+static void watch_brk(int sig)
+{
+	stop = 1;
+}
+
+int bcast_watch(const char *path)
+{
+	struct sockaddr_un addr;
+	struct sigaction sa;
+	char	buf[65536];
+	struct termios saved, raw;
+	ssize_t	n, m, off;
+	int	fd, tty;
+
+	if(strlen(path) >= sizeof(addr.sun_path))
+	{
+		printf("Socket name %s is too long\n", path);
+		return(-1);
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if((fd = socket(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC, 0)) < 0 ||
+		connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		perror(path);
+		return(-1);
+	}
+
+	/* no SA_RESTART, so ^C gets us out of read() */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = watch_brk;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	if((tty = (tcgetattr(0, &saved) == 0)))
+	{
+		raw = saved;
+		raw.c_lflag &= ~(ECHO|ICANON);	/* ISIG stays, for ^C */
+		tcsetattr(0, TCSANOW, &raw);
+	}
+	printf("\033[?25l");		/* hide the cursor */
+	fflush(stdout);
+	while(!stop && (n = read(fd, buf, sizeof(buf))) != 0)
+	{
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+		for(off=0;off<n;off+=m)
+			if((m = write(1, buf+off, n-off)) <= 0)
+			{
+				stop = 1;
+				break;
+			}
+	}
+	close(fd);
+	printf("\033[?25h\n");		/* and show it again */
+	fflush(stdout);
+	if(tty)
+		tcsetattr(0, TCSAFLUSH, &saved);
+	return(0);
+}
@@ -0,0 +1,82 @@
+/*
+ * Name:	bcast.h
+ *
+ * Purpose:     This is the header file for bcast.c, which lets any number
+ *		of spectators watch one running hanoi. Instead of each
+ *		screen running its own copy, "hanoi -S path" listens on a
+ *		UNIX socket, and "hanoi -w path" (or socat, or nc -U)
+ *		connects to it and shows what it is sent.
+ *
+ *		The display encodes the whole screen into a frame at most
+ *		BCAST_FPS times a second. A frame is reference counted and
+ *		shared by every spectator, so it is built once however many
+ *		are watching. A server thread sends it to each of them
+ *		without blocking. A spectator that falls behind finishes the
+ *		frame it is on and then skips straight to the newest one,
+ *		so it never holds up the solver or the other spectators.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	Added bcast_abort and BCAST_LINGER
+ *
+ */
+
+#include <stddef.h>
+
+#define	BCAST_FPS	30	/* most frames sent each second		*/
+#define	BCAST_MAXCLIENTS 256	/* most spectators at once		*/
+#define	BCAST_LINGER	1000	/* mS to wait for slow spectators to	*/
+				/* take the last frame when closing	*/
+
+/* a frame of screen output, shared by every spectator sending it */
+typedef struct frame {
+	int	refs;		/* references held, freed when it hits 0 */
+	size_t	len;		/* bytes of data			*/
+	char	data[];		/* escape sequences and text		*/
+} frame;
+
+/*  bcast_open() listens on the UNIX socket path and starts the server
+ *  thread. Returns 0 on success, -1 on failure.
+ */
+
+int bcast_open(const char *path);
+
+/*  bcast_active() returns nonzero if bcast_open() has been called. */
+
+int bcast_active(void);
+
+/*  bcast_due() returns nonzero if it has been long enough since the
+ *  last frame to send another.
+ */
+
+int bcast_due(void);
+
+/*  bcast_alloc() returns a new frame with room for size bytes and one
+ *  reference, which bcast_publish() takes over.
+ */
+
+frame *bcast_alloc(size_t size);
+
+/*  bcast_publish() makes f the newest frame, and wakes the server
+ *  thread to send it. The caller must not touch f afterwards.
+ */
+
+void bcast_publish(frame *f);
+
+/*  bcast_close() sends the spectators the last frame published, then
+ *  stops the server thread, disconnects them and removes the socket.
+ */
+
+void bcast_close(void);
+
+/*  bcast_abort() just removes the socket. It is safe to call from a
+ *  signal handler, where bcast_close() isn't.
+ */
+
+void bcast_abort(void);
+
+/*  bcast_watch() connects to the socket path and copies what it sends
+ *  to the terminal until the broadcast ends. Returns 0 if it ran, -1
+ *  if it couldn't connect.
+ */
+
+int bcast_watch(const char *path);
@@ -9,18 +9,41 @@
  *		only the standard 80x25 text screen on the PC, and use
  *		the extended character set. See display.h for details.
  *
+ *		The layout is worked out from the size of the terminal,
+ *		and again whenever the terminal is resized. When there are
+ *		more disks than rows to draw them on, each row of a tower
+ *		stands for a band of several disk positions. A band is
+ *		drawn as the biggest disk in it (the bottom one), using
+ *		PARTDISK instead of DISK if the band isn't full. Disk widths
+ *		are scaled to fit too, so any number of disks can be shown,
+ *		and a move only ever redraws the one or two bands it
+ *		touched.
+ *
  * History:	8-6-91		Creation
  *		8-7-91		More work
  *		8-8-91		Added the float stuff
  *		10-29-20	Ported for Linux
+ *		10-19-26	Added seek help and number entry
+ *		10-19-26	Added set_delays and frame_count for benchmarking
+ *		10-19-26	Layout from terminal size, bands for big
+ *				towers, and resizing
+ *		10-19-26	Added USDT probes
+ *		10-19-26	Frames for spectators (see bcast.h)
+ *		10-19-26	Don't wait for a key when too small with -b
+ *		10-19-26	init_display returns -1 when too small
  *
  */
 
 #include "hanoi.h"
 #include "display.h"
+#include "probes.h"
+#include "bcast.h"
 #include <curses.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
 #include <unistd.h>
 // #include <dos.h>
 
@@ -33,17 +56,33 @@ static	int	bottom_row,	/* line to display the base on		*/
 		moves_col,	/* the column for the move #		*/
 		tower_col[3],	/* the columns for each pole		*/
 		numdisks,	/* the number of disks we're using 	*/
+		halfw,		/* widest disk, not counting the pole	*/
+		per,		/* disk positions in each band (row)	*/
+		nbands,		/* bands on each tower			*/
+		too_small,	/* terminal too small to draw on	*/
 		text_len;	/* length of disk text with null	*/
-char	buffer[81];		/* used for drawing the base		*/
 
 /*  these are used to point to text string images of each of the disks.
  *  This greatly speeds display over building them each time a move
- *  is made. The disks are built by makedisk()
+ *  is made. The disks are built by makedisk(). There is one string for
+ *  each width a disk can be drawn at, rather than one for each disk,
+ *  so that the memory used doesn't grow with the number of disks.
  */
-static char	**disk;		/* array of pointers to strings		*/
+static char	**disk;		/* full bands, by width			*/
+static char	**part;		/* partly filled bands, by width	*/
+static char	**flying;	/* disks above the poles (no pole char)	*/
 static char	*empty;		/* pointer to the empty string		*/
+static char	*blank;		/* all spaces, to erase a floating disk	*/
+
+/*  the display keeps its own copy of the towers, so that it can work
+ *  out what a band looks like and redraw everything after a resize.
+ */
+static stack	shadow[3];
 
 static WINDOW *mywindow;
+static	int	delays = 1;	/* 0 to float disks without pausing	*/
+static	unsigned long	last_move; /* last move number shown	*/
+static	volatile sig_atomic_t	resized; /* set by SIGWINCH	*/
 
 
 /* ==================================================================== */
@@ -74,130 +113,413 @@ void makedisk(char *buffer, int num, int disksize)
 
 /* ==================================================================== */
 
-/*  close_display() returns the display to the mode it was in when we
- *  started, frees up allocated memory, and clears the screen.
- */
+/* free_strings() frees the disk images built by build_strings() */
 
-void close_display(void)
+static void free_strings(void)
 {
 	if(disk)
 	{
 		free(disk[0]);
 		free(disk);
 	}
-	if(empty)
-		free(empty);
-    erase();
-    endwin();
+	disk = part = flying = NULL;
+	empty = blank = NULL;
 }
 
 /* ==================================================================== */
 
-/* show_move displays the move number at the correct place */
+/*  build_strings() builds the images of every width of disk, partial
+ *  band and floating disk for the current value of halfw.
+ */
 
-void show_move(int move)
+static void build_strings(void)
 {
-	mvprintw(moves_row,moves_col,"%d",move);
+	int	i;
+	char	*p;
+
+	free_strings();
+	text_len = (halfw*2)+2; /* disk + pole + null */
+
+	/* one array of pointers and one block of text for all of them */
+	if((disk = (char **)malloc(3*(halfw+1)*sizeof(char *))) == NULL)
+	{
+		printf("malloc failure 1 in build_strings()\n");
+		exit(1);
+	}
+	if((disk[0] = (char *)malloc((3*(halfw+1)+1)*text_len)) == NULL)
+	{
+		printf("malloc failure 2 in build_strings()\n");
+		exit(1);
+	}
+	part = disk + (halfw+1);
+	flying = part + (halfw+1);
+
+	/* fill in the array of pointers */
+	for(i=1;i<3*(halfw+1);i++)
+		disk[i] = disk[0] + (i * text_len);
+	blank = disk[0] + (3*(halfw+1) * text_len);
+
+	/* build the disk strings */
+	for(i=0;i<=halfw;i++)
+	{
+		makedisk(disk[i],halfw,i);
+		strcpy(part[i],disk[i]);
+		for(p=part[i];*p;p++)
+			if(*p == DISK)
+				*p = PARTDISK;
+		strcpy(flying[i],disk[i]);
+		flying[i][halfw] = (i ? DISK : ' ');	/* no pole up here */
+	}
+	empty = disk[0];
+	memset(blank,' ',text_len-1);
+	blank[text_len-1] = '\0';
 }
 
 /* ==================================================================== */
 
-/*  init_display() accepts the number of disks to be used, and initializes
- *  all of the display variables. It must be called before any other
- *  display function except max_disp_disks
+/*  layout() works out where everything goes on a LINES x COLS screen.
+ *  The poles are spread evenly across the screen, the disks are as
+ *  wide as will fit between them, and the towers use as many rows as
+ *  there are between the text at the top and the base. If there are
+ *  more disks than rows, the disks are grouped into bands of per
+ *  positions each.
  */
 
-void init_display(int num)
+static void layout(void)
 {
-	int i, tmpy, tmpx;
+	int	i;
+	int	rows;		/* rows we can use for bands */
 
-	numdisks = num;		/* save this in our private variable */
-	text_len = (numdisks*2)+2; /* disk + pole + null */
+	too_small = (LINES < MINLINES) || (COLS < MINCOLS);
+	if(too_small)
+		return;
+
+	for(i=0;i<3;i++)
+		tower_col[i] = (COLS * (2*i+1)) / 6;
+	halfw = (COLS / 6) - 1;
+	if(halfw > numdisks)
+		halfw = numdisks;
+	build_strings();
+
+	bottom_row = LINES-1;	/* bottom row on screen */
+	tower_bot_row = bottom_row - 1;	/* lowest row on towers	*/
+	rows = tower_bot_row - (HEADROWS + 2);
+	per = (numdisks + rows - 1) / rows;
+	nbands = (numdisks + per - 1) / per;
+	tower_top_row = tower_bot_row - nbands; /* top of pole	*/
+	float_row = tower_top_row - 2;	/* for animated display	*/
+}
+
+/* ==================================================================== */
+
+/*  disk_width() returns how many DISK characters to draw on each side
+ *  of the pole for a disk of the given size.
+ */
+
+static int disk_width(int size)
+{
+	if(size <= 0)
+		return(0);
+	return((size*halfw + numdisks-1) / numdisks);
+}
+
+/* ==================================================================== */
+
+/*  draw_band() draws band b of a tower from the shadow copy. The band
+ *  is empty, full, or partly full, and is drawn as its bottom disk.
+ */
 
-	/* allocate space for storage of the disk strings */
-	if((disk = (char **)malloc(numdisks*sizeof(char *))) == NULL)
+static void draw_band(int tower, int b)
+{
+	int	lo;		/* lowest position in the band */
+	int	slots;		/* positions in the band */
+	int	count;		/* disks in the band */
+	char	*str;
+
+	lo = b * per;
+	slots = (numdisks - lo < per) ? numdisks - lo : per;
+	count = shadow[tower].top - lo;
+	if(count <= 0)
+		str = empty;
+	else if(count >= slots)
+		str = disk[disk_width(shadow[tower].layer[lo])];
+	else
+		str = part[disk_width(shadow[tower].layer[lo])];
+	mvaddstr(tower_bot_row-b, tower_col[tower]-halfw, str);
+}
+
+/* ==================================================================== */
+
+/*  draw_row() puts back whatever belongs at a row of a tower, after a
+ *  floating disk has passed through it.
+ */
+
+static void draw_row(int tower, int row)
+{
+	if(row > tower_top_row)
+		draw_band(tower, tower_bot_row-row);
+	else if(row == tower_top_row)
+		mvaddstr(row, tower_col[tower]-halfw, empty);
+	else
+		mvaddstr(row, tower_col[tower]-halfw, blank);
+}
+
+/* ==================================================================== */
+
+/*  close_display() returns the display to the mode it was in when we
+ *  started, frees up allocated memory, and clears the screen.
+ */
+
+void close_display(void)
+{
+	free_strings();
+    erase();
+    endwin();
+}
+
+/* ==================================================================== */
+
+/*  set_delays() turns the pauses in float_disk() on or off. With them
+ *  off, the animation runs as fast as the terminal will take it, which
+ *  is what we want when measuring how much the drawing costs. Nothing
+ *  in here waits for a key either, so call it before init_display().
+ */
+
+void set_delays(int on)
+{
+	delays = on;
+}
+
+/*  broadcast() encodes the whole screen as one frame for spectators,
+ *  each row addressed on its own so a frame can be sent in the middle
+ *  of anything. Curses has already worked out what is on the screen,
+ *  so we just read it back.
+ */
+
+static	int	pending;	/* screen changed since the last frame	*/
+
+static void broadcast(void)
+{
+	frame	*f;
+	chtype	*line;
+	char	*p;
+	int	x,y,n,cy,cx;
+
+	pending = 0;
+	line = malloc((COLS+1) * sizeof(chtype));
+	f = bcast_alloc(LINES * (COLS+16) + 16);
+	if(!line || !f)
 	{
-		printf("malloc failure 1 in init_display()\n");
-		exit(1);
+		free(line);
+		free(f);
+		return;
 	}
-	if((disk[0] = (char *)malloc(numdisks*text_len)) == NULL)
+	getyx(stdscr,cy,cx);
+	p = f->data;
+	for(y=0;y<LINES;y++)
 	{
-		printf("malloc failure 2 in init_display()\n");
-		exit(1);
+		if((n = mvinchnstr(y,0,line,COLS)) == ERR)
+			n = 0;
+		while((n > 0) && ((line[n-1] & A_CHARTEXT) == ' '))
+			n--;
+		p += sprintf(p,"\033[%d;1H",y+1);
+		for(x=0;x<n;x++)
+			*p++ = line[x] & A_CHARTEXT;
+		memcpy(p,"\033[K",3);
+		p += 3;
 	}
-	if((empty = (char *)malloc(text_len)) == NULL)
+	memcpy(p,"\033[J",3);	/* in case the screen got smaller */
+	p += 3;
+	move(cy,cx);
+	free(line);
+	f->len = p - f->data;
+	bcast_publish(f);
+}
+
+/*  update() is used everywhere in place of refresh(), so that we can
+ *  count the frames drawn, and pass them on to any spectators.
+ */
+
+static	unsigned long	frames;	/* number of refresh() calls so far	*/
+
+static void update(void)
+{
+	frames++;
+	PROBE1(refresh_entry,frames);
+	refresh();
+	PROBE1(refresh_return,frames);
+	if(bcast_active())
 	{
-		printf("malloc failure 3 in init_display()\n");
-		exit(1);
+		pending = 1;
+		if(bcast_due())
+			broadcast();
 	}
+}
 
-	/* fill in the array of pointers */
-	for(i=1;i<numdisks;i++)
-		disk[i] = disk[0] + (i * text_len);
+/*  idle_display() makes sure the spectators have the last frame drawn,
+ *  since update() may have skipped it. Call it before waiting.
+ */
 
-	/* build the disk strings */
-	for(i=0;i<numdisks;i++)
-		makedisk(disk[i],numdisks,i+1);
-	makedisk(empty,numdisks,0);
-
-	/* set up the location of the poles */
-	/* this could be calculated, but I assume an 80 column display */
-	tower_col[0] = 14;
-	tower_col[1] = 40;
-	tower_col[2] = 66;
-
-	for(i=0;i<80;i++)				/* build base */
-		buffer[i] = BASE;
+void idle_display(void)
+{
+	if(pending)
+		broadcast();
+}
+
+/* frame_count() returns the number of frames drawn so far */
+
+unsigned long frame_count(void)
+{
+	return(frames);
+}
+
+/* pause_ms() waits for ms milliseconds, unless delays are turned off */
+
+static void pause_ms(int ms)
+{
+	if(delays)
+		usleep(ms * 1000);
+}
+
+/* ==================================================================== */
+
+/*  draw_screen() clears the screen and draws everything on it: the
+ *  text at the top, the base, and all of the towers.
+ */
+
+static void draw_screen(void)
+{
+	int	i,b;
+
+	clear();
+	if(too_small)
+	{
+		mvprintw(1,1,"Terminal must be at least %dx%d",
+			MINLINES,MINCOLS);
+		update();
+		return;
+	}
+
+	mvhline(bottom_row,0,BASE,COLS);		/* the base */
 	for(i=0;i<3;i++)				/* and poles */
-		buffer[tower_col[i]-1] = BASEWPOLE;
-	buffer[80] = '\0';           			/* and terminator */
+		mvaddch(bottom_row,tower_col[i],BASEWPOLE);
+	mvprintw(1,COLS/2-9,"The Towers of Hanoi");
+	mvprintw(2,COLS/2-12,"Programmer: Steve Conklin");
+	mvprintw(5,COLS/2-3,"Moves: ");
+	getyx(mywindow, moves_row, moves_col);
+	printw("%lu",last_move);
+	if(per > 1)
+		mvprintw(6,COLS/2-18,"%d disks to a row, %c if not full",
+			per,PARTDISK);
+
+	for(i=0;i<3;i++)
+	{
+		for(b=0;b<nbands;b++)
+			draw_band(i,b);
+		mvaddstr(tower_top_row,tower_col[i]-halfw,empty);
+	}
+	update();
+}
+
+/* ==================================================================== */
+
+/* sig_winch() is the SIGWINCH handler, the real work is in check_resize() */
+
+static void sig_winch(int sig)
+{
+	resized = 1;
+}
+
+/*  check_resize() lays the screen out again if the terminal has changed
+ *  size since we last looked. It is called between moves, so it never
+ *  upsets a disk in the middle of floating.
+ */
+
+static void check_resize(void)
+{
+	struct winsize ws;
+
+	if(!resized)
+		return;
+	resized = 0;
+	if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0)
+		resizeterm(ws.ws_row, ws.ws_col);
+	layout();
+	PROBE2(resize,LINES,COLS);
+	draw_screen();
+}
+
+/* ==================================================================== */
+
+/* show_move displays the move number at the correct place */
+
+void show_move(unsigned long move)
+{
+	check_resize();
+	last_move = move;
+	if(too_small)
+		return;
+	mvprintw(moves_row,moves_col,"%lu",move);
+	clrtoeol();	/* a seek can make the number shorter */
+}
+
+/* ==================================================================== */
+
+/*  init_display() accepts the number of disks to be used, and initializes
+ *  all of the display variables. It must be called before any other
+ *  display function except max_disp_disks
+ */
+
+int	init_display(int num)
+{
+	struct sigaction sa;
+
+	numdisks = num;		/* save this in our private variable */
 
 	/* clear screen and display the text */
 
     mywindow = initscr();
     cbreak();
     noecho();
-	clear();
+    keypad(mywindow,TRUE);
     scrollok(mywindow,FALSE);
     curs_set(0);
 
-    if ((LINES < 40) || (COLS < 80)) {
-        mvprintw(1,1,"Terminal must be at least 40x80");
-        mvprintw(2,1,"     Press any key to exit");
-        refresh();
-        getchar();
+	layout();
+    if (too_small) {
+        draw_screen();
+	if(delays)		/* nobody to press a key for -b */
+	{
+		mvprintw(2,1,"     Press any key to exit");
+		update();
+		getch();
+	}
         close_display();
-        exit(-1);
-        
+	printf("Terminal must be at least %dx%d\n",MINLINES,MINCOLS);
+	return(-1);	/* the caller has things to clean up */
     }
 
-	bottom_row = LINES-1;	/* bottom row on screen */
-    printf("lines = %d\n", LINES-1);
-	tower_bot_row = bottom_row - 1;	/* lowest row on towers	*/
-	tower_top_row = tower_bot_row - num; /* top of pole	*/
-	float_row = tower_top_row - 2;	/* for animated display	*/
-    
-	mvprintw(bottom_row,1,"%s",buffer);
-	mvprintw(1,31,"The Towers of Hanoi");
-	mvprintw(2,28,"Programmer: Steve Conklin");
-	mvprintw(5,37,"Moves: ");
-    getyx(mywindow, tmpy, tmpx);
-    moves_row = tmpy;
-    moves_col = tmpx;
-    printf("%d %d\n", moves_row, moves_col);
-	printw("0");
-    refresh();
+	/*  catch resizes ourselves, without SA_RESTART, so that a getch()
+	 *  waiting for a key returns and we get to redraw
+	 */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = sig_winch;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGWINCH, &sa, NULL);
+
+	draw_screen();
+	return(0);
 }
 
 /* ==================================================================== */
 
 /*  max_disp_disks() returns the maximum number of disks that the display
- *  can handle. Since I assume an 80 column screen, I hard-coded to 12.
+ *  can handle. Big towers are drawn in bands, so this is just MAXDISKS.
  */
 
 int	max_disp_disks(void)
 {
-	return(12);
+	return(MAXDISKS);
 }
 
 /* ==================================================================== */
@@ -206,47 +528,85 @@ int	max_disp_disks(void)
 
 void press_msg(void)
 {
+	check_resize();
 	mvprintw(8,10,"Press any key to continue.");
-    refresh();
+    update();
+	idle_display();
 }
 
 /* ==================================================================== */
 
-/* remove_disk removes a disk from a pole by drawing a blank disk */
+/*  show_seek_help() lists the seek keys used at speed 3, along with
+ *  the current size of a +/- jump.
+ */
 
-void remove_disk(int tower, int height)
+void show_seek_help(unsigned long jump)
 {
-	/* height starts at 0 for lowest row */
-	mvprintw(tower_bot_row-height, tower_col[tower]-numdisks,"%s",empty);
-    refresh();
+	mvprintw(10,10,"b: back  +/-: jump %lu  </>: jump size",jump);
+	clrtoeol();
+	mvprintw(11,10,"g: go to move  %%: go to percent  q: quit");
+	update();
 }
 
 /* ==================================================================== */
 
-/* put_disk() draws a disk on a tower at the given height */
+/*  get_string() prompts for a line of text on the prompt row and reads
+ *  it into buf, which is len characters long. The prompt is erased
+ *  afterwards. Returns the length of the text typed.
+ */
 
-void put_disk(int tower, int height, int size)
+int get_string(const char *prompt, char *buf, int len)
 {
-	mvprintw(tower_bot_row-height,tower_col[tower]-numdisks,"%s", disk[size-1]);
-    refresh();
+	mvprintw(12,10,"%s",prompt);
+	clrtoeol();
+	if(bcast_active())	/* so spectators see the prompt */
+		broadcast();
+	echo();
+	curs_set(1);
+	if(getnstr(buf,len-1) == ERR)
+		buf[0] = '\0';
+	curs_set(0);
+	noecho();
+	move(12,0);
+	clrtoeol();
+	update();
+	return(strlen(buf));
 }
 
 /* ==================================================================== */
 
-/*  movetext() is a curses reeplacement for the Borland function
- * used in the original code.
- *
- * NOTE: The Borland code could operatte over multiple lines, but it
- * is only used over a single line in this program, so that's assumed.
+/*  remove_disk removes a disk from a pole by redrawing the band it was
+ *  in, which is a blank disk unless the band holds other disks too.
  */
 
-chtype chbuf[81];
-char space = ' ';
-void movetext(int left, int top, int right, int bottom, int newleft, int newtop)
+void remove_disk(int tower, int height)
 {
-    mvinchnstr(top, left, chbuf, right-left);
-    mvaddchstr(newtop, newleft, chbuf);
-    return;
+	/* height starts at 0 for lowest row */
+	PROBE2(remove_disk_entry,tower,height);
+	shadow[tower].top = height;
+	if(!too_small)
+	{
+		draw_band(tower, height/per);
+		update();
+	}
+	PROBE0(remove_disk_return);
+}
+
+/* ==================================================================== */
+
+/* put_disk() draws a disk on a tower at the given height */
+
+void put_disk(int tower, int height, int size)
+{
+	PROBE3(put_disk_entry,tower,height,size);
+	shadow[tower].layer[height] = size;
+	shadow[tower].top = height+1;
+	if(!too_small)
+	{
+		draw_band(tower, height/per);
+		update();
+	}
+	PROBE0(put_disk_return);
 }
 
 /* ==================================================================== */
@@ -256,16 +616,35 @@ void movetext(int left, int top, int right, int bottom, int newleft, int newtop)
  *  and height fr_h to tower to_tow and height to_h. The speed of
  *  the movement is governed by VDEL and HDEL which are defined in
  *  display.h
+ *
+ *  Each step puts back what belongs where the disk was (see draw_row)
+ *  and draws the disk in its new place, so only one row changes per
+ *  frame whatever the size of the towers.
  */
 
 void float_disk(int fr_tow, int to_tow, int fr_h, int to_h)
 {
-	int	fr_col;	/* from column, used to track location	*/
-	int	to_col;	/* to column				*/
-	int	len;	/* length of text to move		*/
+	int	col;	/* column the disk text starts in	*/
+	int	to_col;	/* column it has to get to		*/
+	int	row;	/* row the disk is on			*/
+	int	to_row;	/* row it has to get to			*/
+	int	len;	/* length of the disk text		*/
 	int	dir;	/* direction to float disk		*/
+	int	size;	/* size of the disk being moved		*/
+	int	w;	/* and how wide it is drawn		*/
+
+	PROBE4(float_disk_entry,fr_tow,to_tow,fr_h,to_h);
+	size = shadow[fr_tow].layer[fr_h];
+	shadow[fr_tow].top = fr_h;	/* it has left the tower */
+	if(too_small)
+	{
+		put_disk(to_tow,to_h,size);
+		PROBE0(float_disk_return);
+		return;
+	}
 
-	len = (2*numdisks)+1;	/* the length of the text to move */
+	len = (2*halfw)+1;	/* the length of the text to move */
+	w = disk_width(size);
 
 	/* set up the direction to move (left or right) */
 	if((fr_tow==0)||(to_tow==2))
@@ -274,69 +653,48 @@ void float_disk(int fr_tow, int to_tow, int fr_h, int to_h)
 		dir = LEFT;		/* to the left	*/
 
 	/* calculate actual screen locations */
-	fr_col = tower_col[fr_tow] - numdisks;
-	to_col = tower_col[to_tow] - numdisks;
-	fr_h = tower_bot_row-fr_h;
-	to_h = tower_bot_row-to_h;
+	col = tower_col[fr_tow] - halfw;
+	to_col = tower_col[to_tow] - halfw;
+	row = tower_bot_row - fr_h/per;
+	to_row = tower_bot_row - to_h/per;
 
-	/* move the disk up to the float row */
-	while(fr_h >= tower_top_row)
+	/* move the disk up to the float row, leaving the pole behind */
+	while(row > float_row)
 	{
-		usleep(VDEL * 1000);
-		movetext(fr_col,fr_h,fr_col+len,fr_h,fr_col,fr_h-1);
-        mvprintw(fr_h,fr_col,"%s", empty);
-		fr_h--;
-        refresh();
-	}
-
-	/* we are just above the pole, so remove the pole char */
-    mvprintw(fr_h,fr_col+numdisks," ");	/* make a hole in the disk */
-    refresh();
-	while(fr_h > float_row)
-	{
-		usleep(VDEL * 1000);
-		movetext(fr_col,fr_h,fr_col+len,fr_h,fr_col,fr_h-1);
-        mvprintw(fr_h,fr_col,"%s",empty); // draws pole only
-        mvprintw(fr_h,fr_col+numdisks, " "); // removes pole
-		fr_h--;
-        refresh();
+		pause_ms(VDEL);
+		draw_row(fr_tow,row);
+		row--;
+		mvaddstr(row,col,(row >= tower_top_row) ? disk[w] : flying[w]);
+		update();
 	}
 
 	/* move the disk over the destination pole */
-	while(fr_col != to_col)
+	while(col != to_col)
 	{
-		usleep(HDEL * 1000);
-		/* index fudges on next lines prevent leftover chars */
-		if(dir == RIGHT) /* moving right */
-			movetext(fr_col-1,fr_h,fr_col+len,fr_h,
-				fr_col,fr_h);
-		else      /* moving left */
-			movetext(fr_col,fr_h,fr_col+len+1,fr_h,
-				fr_col-1,fr_h);
-		fr_col += dir;
-        refresh();
+		pause_ms(HDEL);
+		/* blank the end we are moving away from */
+		mvaddch(row,(dir == RIGHT) ? col : col+len-1,' ');
+		col += dir;
+		mvaddstr(row,col,flying[w]);
+		update();
 	}
 
-	/* lower the disk to the correct height */
-	while(fr_h < tower_top_row)
-	{
-		usleep(VDEL * 1000);
-		movetext(fr_col,fr_h,fr_col+len,fr_h,fr_col,fr_h+1);
-        mvprintw(fr_h,fr_col,"%s",empty);
-        mvprintw(fr_h,fr_col+numdisks," ");
-		fr_h++;
-        refresh();
-	}
-	/* put the pole char back into the disk */
-    mvprintw(fr_h,to_col+numdisks,"%c", POLE);
-	while(fr_h < to_h)
+	/* lower the disk, into its band on the last step */
+	shadow[to_tow].layer[to_h] = size;
+	shadow[to_tow].top = to_h+1;
+	while(row < to_row)
 	{
-		usleep(VDEL * 1000);
-		movetext(fr_col,fr_h,fr_col+len,fr_h,fr_col,fr_h+1);
-        mvprintw(fr_h,fr_col,"%s",empty);
-		fr_h++;
-        refresh();
+		pause_ms(VDEL);
+		draw_row(to_tow,row);
+		row++;
+		if(row == to_row)
+			draw_band(to_tow,to_h/per);
+		else
+			mvaddstr(row,col,(row >= tower_top_row) ?
+				disk[w] : flying[w]);
+		update();
 	}
+	PROBE0(float_disk_return);
 }
 
 /* ==================================================================== */
@@ -345,25 +703,21 @@ void float_disk(int fr_tow, int to_tow, int fr_h, int to_h)
 
 void show_towers(stack tower[])
 {
-	int	start_col;	/* beginning of text for a tower */
-	int	i,j;		/* loop counters */
-	int	row;		/* loop counter */
-	int	disksize;	/* size of disk to draw */
+	int	i,b;		/* loop counters */
 
-	for(i=0;i<3;i++)	/* for each tower */
+	PROBE0(show_towers_entry);
+	memcpy(shadow,tower,3*sizeof(stack));
+	if(!too_small)
 	{
-		start_col = tower_col[i] - numdisks;
-		/* draw any disks that are on the tower */
-		for(j=0,row=tower_bot_row;j<tower[i].top;j++,row--)
-		{
-			disksize = tower[i].layer[j];
-            mvprintw(row,start_col,"%s",disk[disksize-1]);
-		}
-		/* and extend the pole to the top */
-		while(row >= tower_top_row)
+		for(i=0;i<3;i++)	/* for each tower */
 		{
-            mvprintw(row--,start_col,"%s",empty); /* blank lines with pole */
+			/* draw each band, disks or just the pole */
+			for(b=0;b<nbands;b++)
+				draw_band(i,b);
+			/* and the top of the pole */
+			mvaddstr(tower_top_row,tower_col[i]-halfw,empty);
 		}
+		update();
 	}
-    refresh();
+	PROBE0(show_towers_return);
 }
@@ -10,6 +10,11 @@
  *		8-7-91		More work
  *		8-8-91		added float_disk
  *		10-29-20	Ported for Linux
+ *		10-19-26	Added show_seek_help and get_string
+ *		10-19-26	Added set_delays and frame_count
+ *		10-19-26	Added PARTDISK and the screen size limits
+ *		10-19-26	Added idle_display
+ *		10-19-26	init_display returns -1 if the terminal is too small
  *
  */
 
@@ -24,6 +29,10 @@
 #define	LEFT	-1		/* direction for float movement	*/
 #define	RIGHT	1
 
+#define	MINLINES	20	/* smallest terminal we can draw on	*/
+#define	MINCOLS		60
+#define	HEADROWS	13	/* rows used for text above the towers	*/
+
 /*  These are the character codes for the text representations
  *  of various parts to be drawn. The original program used the PC extended character
  *  set.
@@ -38,23 +47,26 @@
 #define BASEWPOLE	'+'	/* where the base and pole meet		*/
 #define DISK		'='	/* the solid block for the disk		*/
 #define POLE		'|'	/* the pole character			*/
+#define PARTDISK	':'	/* a row of disks that isn't full	*/
 
 /*  init_display() accepts the number of disks to be used and initializes
  *  the display software and hardware. This function must be called
- *  before any other display function except max_disp_disks()
+ *  before any other display function except max_disp_disks() and
+ *  set_delays(). It returns -1, with the display already closed, if
+ *  the terminal is too small, or 0 if all is well.
  */
  
-void init_display(int num);
+int	init_display(int num);
 
 /*  show_move() displays the integer passed to it as text at the
  *  end of the "Moves: " on the screen. This is called to display
  *  the current move number.
  */
 
-void show_move(int move);
+void show_move(unsigned long move);
 
-/*  makedisk builds a disk image in a character array. num is the number
- *  of disks we are using, and disksize is the size of the disk we are
+/*  makedisk builds a disk image in a character array. num is the widest
+ *  disk we will draw, and disksize is the width of the disk we are
  *  building. The array must be (2*num)+2 characters long.
  */
 
@@ -78,6 +90,19 @@ void close_display(void);
  
 void press_msg(void);
 
+/*  show_seek_help() displays the keys which can be used to seek at
+ *  speed 3, and the number of moves a + or - will jump.
+ */
+
+void show_seek_help(unsigned long jump);
+
+/*  get_string() displays prompt and reads a line typed by the user
+ *  into buf, which holds len characters. It returns the length of
+ *  the line.
+ */
+
+int get_string(const char *prompt, char *buf, int len);
+
 /*  remove_disk() removes a disk from a tower by writing a blank disk
  *  over it.
  */
@@ -98,8 +123,29 @@ void put_disk(int tower, int height, int size);
 
 void float_disk(int fr_tow, int to_tow, int fr_h, int to_h);
 
+/*  set_delays() turns the VDEL and HDEL pauses in float_disk(), and
+ *  waiting for a key if the terminal is too small, on (the default) or
+ *  off. It can be called before init_display().
+ */
+
+void set_delays(int on);
+
+/*  frame_count() returns the number of times the screen has been
+ *  refreshed since init_display().
+ */
+
+unsigned long frame_count(void);
+
+/*  idle_display() sends spectators the latest frame if they haven't
+ *  had it yet. Frames are sent at most BCAST_FPS times a second, so
+ *  call this before sleeping or waiting for a key.
+ */
+
+void idle_display(void);
+
 /*  max_disp_disks returns the maximum number of disks that the
- *  display can handle
+ *  display can handle. When there are more disks than rows on the
+ *  screen, several disks share a row.
  */
 
 int max_disp_disks(void);
@@ -14,6 +14,14 @@
  *		8-7-91		Lot of work! done, needs clean-up
  *		8-8-91		Added float_disk stuff. Done!
  *		10-29-20	Ported for Linux
+ *		10-19-26	Added shared memory status publishing
+ *		10-19-26	Added seeking at speed 3
+ *		10-19-26	Added -b for benchmarking
+ *		10-19-26	Added -o to write a trace file
+ *		10-19-26	Added USDT probes
+ *		10-19-26	Added -S and -w for spectators
+ *		10-19-26	-b times the moves for hanoibench
+ *		10-19-26	q at speed 3 shuts down like the end of a run
  *
  */
 
@@ -21,9 +29,15 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <curses.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include "hanoi.h"
 #include "display.h"
+#include "shm.h"
+#include "trace.h"
+#include "probes.h"
+#include "bcast.h"
 
 /* =================================================================== */
 
@@ -49,13 +63,51 @@ void	init_stacks(stack *tower, int disks)
 	}
 	/* set up the starting stack */
 	tower[SOURCE].top = disks;
-	for(i=0,j=disks;j>=0;i++,j--)
+	for(i=0,j=disks;j>0;i++,j--)
 		tower[SOURCE].layer[i] = j;
 	for(;i<MAXDISKS;i++)
 		tower[SOURCE].layer[i] = 0;
 }
 /* ===================================================================== */
 
+/*  set_position() rebuilds the towers as they stand after move number
+ *  moves, without replaying any of the moves before it. It returns the
+ *  tower the small disk is on.
+ *
+ *  Disk k (1 is the smallest) first moves on move 2^(k-1) and then
+ *  every 2^k moves after that, so by move m it has moved
+ *  (m + 2^(k-1)) / 2^k times. Every disk always steps around the
+ *  towers in the same direction - the small disk goes the way dir
+ *  says, the next one the other way, and so on alternately - so the
+ *  count mod 3 tells us where the disk is. Sizes are pushed largest
+ *  first, which leaves each tower in the right order.
+ */
+
+int	set_position(stack *tower, int disks, int dir, unsigned long moves)
+{
+	int	k;		/* disk size */
+	int	peg;		/* where disk k ends up */
+	int	step;		/* 1 or 2: which way disk k travels */
+	int	smallon = SOURCE;
+	unsigned long count;	/* times disk k has moved */
+
+	memset(tower, 0, 3 * sizeof(stack));
+	for(k=disks;k>=1;k--)
+	{
+		/* (m + 2^(k-1)) >> k, without overflowing at 64 disks */
+		count = (k < 64) ? (moves >> k) : 0;
+		count += (moves >> (k-1)) & 1;
+		step = (k & 1) ? dir : 3 - dir;
+		peg = (int)((count % 3) * step % 3);
+		push_stack(peg, k);
+		if(k == 1)
+			smallon = peg;
+	}
+	return(smallon);
+}
+
+/* ===================================================================== */
+
 /*  print a usage message - accepts the maximum number of disks that
  *  can be accomodated
  */
@@ -63,17 +115,67 @@ void	init_stacks(stack *tower, int disks)
 void usage(int max)
 {
 	printf("\nhanoi - solves the towers of hanoi\n");
-	printf("usage: hanoi [num_disks] [speed]\n\n");
+	printf("usage: hanoi [-b] [-m name] [-i moves] [-S socket] ");
+	printf("[num_disks] [speed]\n");
+	printf("       hanoi -o file [-t threads] [-r] [num_disks]\n");
+	printf("       hanoi -w socket\n\n");
 	printf("where:\n\tnum_disks is the number of disks to solve for, ");
 	printf("up to a maximum of %d.\n",max);
 	printf("\tand speed is one of the following values:\n\n");
 	printf("\t1 - No delay between moves, for large numbers of disks.\n");
 	printf("\t2 - 1 second delay between moves\n");
-	printf("\t3 - press a key to continue with each move\n");
+	printf("\t3 - press a key to continue with each move, or seek:\n");
+	printf("\t    b back one move, +/- jump 10^k moves, </> change k,\n");
+	printf("\t    g go to a move number, %% go to a percentage,");
+	printf(" q quit\n");
 	printf("\t4 - animated display - cute, but slow\n");
 	printf("\nIf a number of disks is not specified, it defaults to %d\n",
 		DEFDISKS);
 	printf("If a speed is not specified, it defaults to 4\n");
+	printf("\n\t-b       never pauses or waits for a key, so the ");
+	printf("cost of\n\t\t drawing can be measured (see hanoibench).");
+	printf(" The number\n\t\t of frames drawn, the nanoseconds ");
+	printf("from the first move to\n\t\t the last, and the slowest ");
+	printf("move are written to file\n\t\t descriptor 3.\n");
+	printf("\t-m name  publishes the state of the run in shared ");
+	printf("memory\n\t\t as name, for hanoimon to read\n");
+	printf("\t-i moves is the number of moves between publishes ");
+	printf("(default %d)\n", SHM_DEFINTERVAL);
+	printf("\t-o file  writes every move to file instead of showing ");
+	printf("them, up to\n\t\t %d disks (see trace.h)\n", MAXDISKS);
+	printf("\t-t num   is the number of threads generating moves for ");
+	printf("-o (default %d)\n", TRACE_DEFTHREADS);
+	printf("\t-r       resumes a trace file which was cut short\n");
+	printf("\t-S path  also shows the run to spectators connecting ");
+	printf("to the\n\t\t UNIX socket path\n");
+	printf("\t-w path  watches the run being shown on the socket path\n");
+}
+
+/* ===================================================================== */
+
+/* now_ns() returns the time in nanoseconds, for timing moves */
+
+unsigned long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return(ts.tv_sec * 1000000000UL + ts.tv_nsec);
+}
+
+/* ===================================================================== */
+
+/*  shut_down() puts everything away at the end of a run, or when the
+ *  user quits: spectators get the last frame, then the display, the
+ *  broadcast and the shared memory are closed.
+ */
+
+void shut_down(void)
+{
+	idle_display();
+	bcast_close();
+	close_display();
+	shm_close_status();
 }
 
 /* ===================================================================== */
@@ -81,12 +183,91 @@ void usage(int max)
 /* the user interrupt handler  - we come here if ^C hit */
 void c_brk(int foo)
 {
+	bcast_abort();		/* no waiting for threads in here */
 	close_display();
+	shm_close_status();
 	printf("User Interrupt.\n");
     exit(0);
 }
 /* ===================================================================== */
 
+/*  get_command() is used at speed 3. It waits for a key, and if it
+ *  was a seek command, sets *moves to the move number the user wants
+ *  to look at (always between 0 and total) and returns 1. q returns
+ *  -1, meaning quit. Any other key returns 0, which means carry on
+ *  with the next move as usual.
+ */
+
+int	get_command(unsigned long *moves, unsigned long total)
+{
+	static int	k;		/* jumps are 10^k moves */
+	unsigned long	jump;		/* 10^k */
+	unsigned long	m = *moves;
+	char	line[32];		/* typed move number or percentage */
+	double	pct;
+	int	i;
+
+	for(;;)
+	{
+		for(i=0,jump=1;i<k;i++)
+			jump *= 10;
+		show_seek_help(jump);
+		press_msg();
+		switch(getch())
+		{
+			case 'b':		/* back a move */
+			case KEY_LEFT:
+			case KEY_BACKSPACE:
+				*moves = m ? m-1 : 0;
+				return(1);
+			case '+':		/* forward 10^k */
+			case KEY_NPAGE:
+				*moves = (total-m > jump) ? m+jump : total;
+				return(1);
+			case '-':		/* back 10^k */
+			case KEY_PPAGE:
+				*moves = (m > jump) ? m-jump : 0;
+				return(1);
+			case '>':		/* bigger jumps */
+			case KEY_UP:
+				if(k < 19)
+					k++;
+				break;
+			case '<':		/* smaller jumps */
+			case KEY_DOWN:
+				if(k > 0)
+					k--;
+				break;
+			case 'g':		/* go to a move number */
+				if(!get_string("Go to move: ",line,sizeof(line)))
+					break;
+				m = strtoul(line,NULL,10);
+				*moves = (m > total) ? total : m;
+				return(1);
+			case '%':		/* go to a percentage of the run */
+				if(!get_string("Go to percent: ",line,sizeof(line)))
+					break;
+				pct = atof(line);
+				if(pct <= 0)
+					*moves = 0;
+				else if(pct >= 100)
+					*moves = total;
+				else
+					*moves = (long double)total * pct / 100;
+				return(1);
+			case 'q':		/* give up */
+				return(-1);
+			case ERR:		/* interrupted by a resize */
+			case KEY_RESIZE:
+				break;
+			default:		/* carry on */
+				return(0);
+		}
+	}
+}
+
+/* ===================================================================== */
+
 /* This is the workhorse */
 
 int main(int argc, char *argv[])
@@ -104,12 +285,28 @@ int main(int argc, char *argv[])
 				/* 1 for cw (even # of disks)		*/
 				/* or 2 for ccw (odd # of disks)	*/
 	int	speed = 0;	/* selects display method		*/
+	int	cmd = 0;	/* last get_command(), -1 to quit	*/
 	/* these are used to keep track of what was done for display later */
 	int	fr_tow;		/* tower the move was from		*/
 	int	to_tow;		/* tower the move was to		*/
 	int	fr_h;		/* height the move was from		*/
 	int	to_h;		/* height the move was to		*/
 	int	size_moved;	/* size of the disk moved		*/
+	char	*shm_name = NULL; /* shared memory name, if publishing	*/
+	int	interval = SHM_DEFINTERVAL; /* moves between publishes	*/
+	int	c;		/* option letter			*/
+	int	nowait = 0;	/* -b: no pauses or keypresses at all	*/
+	char	*trace_name = NULL; /* -o: trace file to write		*/
+	int	threads = TRACE_DEFTHREADS; /* -t: threads for the trace */
+	int	resume = 0;	/* -r: carry on with a partial trace	*/
+	char	*sock_name = NULL; /* -S: socket to show spectators on	*/
+	char	*watch_name = NULL; /* -w: socket to watch		*/
+	unsigned long total;	/* moves needed to solve (2^disks - 1)	*/
+	/* with -b, each move is timed, from working it out to drawing it */
+	unsigned long start_ns = 0; /* when this move started		*/
+	unsigned long first_ns = 0; /* when the first one started	*/
+	unsigned long last_ns = 0; /* when the last one finished	*/
+	unsigned long max_ns = 0; /* the slowest move			*/
 
 	/* set the user interrupt handler */
     signal(SIGINT, c_brk);
@@ -117,7 +314,45 @@ int main(int argc, char *argv[])
 	tmp = max_disp_disks();	/* find out how many the display can handle */
 	max_can_do = (MAXDISKS>tmp)?tmp:MAXDISKS; /* select the smaller */
 
-	/* check the command line */
+	/* check the command line, options first */
+	while((c = getopt(argc, argv, "bm:i:o:t:rS:w:")) != -1)
+	{
+		switch(c)
+		{
+			case 'b':		/* benchmark, never wait */
+				nowait = 1;
+				break;
+			case 'm':		/* publish in shared memory */
+				shm_name = optarg;
+				break;
+			case 'i':		/* publish interval */
+				interval = atoi(optarg);
+				break;
+			case 'o':		/* write a trace file */
+				trace_name = optarg;
+				break;
+			case 't':		/* trace threads */
+				threads = atoi(optarg);
+				break;
+			case 'r':		/* resume the trace */
+				resume = 1;
+				break;
+			case 'S':		/* show spectators */
+				sock_name = optarg;
+				break;
+			case 'w':		/* be a spectator */
+				watch_name = optarg;
+				break;
+			default:
+				usage(max_can_do);
+				exit(1);
+		}
+	}
+	/* a spectator doesn't solve anything itself */
+	if(watch_name)
+		exit(bcast_watch(watch_name) ? 1 : 0);
+	argc -= optind - 1;		/* so the switch below sees only */
+	argv += optind - 1;		/* the disks and speed		 */
 	switch(argc)
 	{
 		case 1:				/* use defaults	*/
@@ -145,6 +380,10 @@ int main(int argc, char *argv[])
 		exit(1);
 	}
 
+	/* writing a trace doesn't use the display at all */
+	if(trace_name)
+		exit(write_trace(trace_name,disks,threads,resume) ? 1 : 0);
+
 	/* check the speed specified */
 	if((!speed) || (speed>4))
 		speed = 4;	/* default to animated display */
@@ -158,20 +397,48 @@ int main(int argc, char *argv[])
 	else
 		dir = 2;	/* ccw */
 
+	/* 2^64 - 1 doesn't fit a shift, but it fits the variable */
+	total = (disks >= 64) ? ~0UL : (1UL << disks) - 1;
+
 	/* initalize the data structures and display */
 	init_stacks(tower,disks);
-	init_display(disks);
+	if(shm_name && (shm_open_status(shm_name,disks,speed,interval) < 0))
+		exit(1);
+	if(sock_name && (bcast_open(sock_name) < 0))
+	{
+		shm_close_status();
+		exit(1);
+	}
+	if(nowait)		/* before init_display(), which may wait */
+		set_delays(0);
+	if(init_display(disks) < 0)	/* terminal too small */
+	{
+		bcast_close();
+		shm_close_status();
+		exit(-1);
+	}
+	shm_force_publish(moves,tower);
 	/* do the initial display and pause to give a good look */
 	show_towers(tower);
-	usleep(1000);
+	if(!nowait)
+		usleep(1000);
 
 	/* we start with the small disk on the SOURCE peg */
 	smallon = 0;
 	/* wait for a keypress if appropriate */
-	if(speed == 3)
+	if((speed == 3) && !nowait)
 	{
-		press_msg();
-        getchar();
+		/*  the user may seek anywhere from here. The towers
+		 *  are rebuilt from the move number, so even a jump
+		 *  of 2^60 moves is instant.
+		 */
+		while((cmd = get_command(&moves,total)) > 0)
+		{
+			smallon = set_position(tower,disks,dir,moves);
+			show_towers(tower);
+			show_move(moves);
+			shm_force_publish(moves,tower);
+		}
 	}
 
 	/*  The algorithm used here is not recursive, but yields the
@@ -188,8 +455,10 @@ int main(int argc, char *argv[])
 	 *  always ends up on the TARGET tower.
 	 */
 
-	while(!(STACK_EMPTY(SOURCE) && STACK_EMPTY(TEMP)))
+	while((cmd >= 0) && !(STACK_EMPTY(SOURCE) && STACK_EMPTY(TEMP)))
 	{
+		if(nowait)
+			start_ns = now_ns();
 		moves++;
 		tmp = AFTER(smallon);	/* the next peg */
 		if(moves & 1L)		/* it's an odd numbered move */
@@ -231,6 +500,10 @@ int main(int argc, char *argv[])
 			size_moved = TOP_SIZE(fr_tow);
 			push_stack(to_tow,pop_stack(fr_tow));/* do the move */
 		}
+		PROBE4(move,moves,size_moved,fr_tow,to_tow);
+		if(!(moves & (BATCH-1)))
+			PROBE1(batch,moves);
+		shm_publish(moves,tower,fr_tow,to_tow); /* let watchers know */
 		show_move(moves);	/* display the move number */
 		switch(speed)	/* select the display update method */
 		{
@@ -241,13 +514,24 @@ int main(int argc, char *argv[])
 			case 2:	/* delay 1 sec for each move */
 				remove_disk(fr_tow,fr_h);
 				put_disk(to_tow,to_h,size_moved);
-				sleep(1);
+				if(!nowait)
+				{
+					idle_display();
+					sleep(1);
+				}
 				break;
 			case 3:	/* wait for ketpress */
 				remove_disk(fr_tow,fr_h);
 				put_disk(to_tow,to_h,size_moved);
-				press_msg();
-				getchar();
+				/* let the user seek, as above */
+				while(!nowait &&
+					((cmd = get_command(&moves,total)) > 0))
+				{
+					smallon = set_position(tower,disks,dir,moves);
+					show_towers(tower);
+					show_move(moves);
+					shm_force_publish(moves,tower);
+				}
 				break;
 			case 4:	/* animated display */
 				float_disk(fr_tow,to_tow,fr_h,to_h);
@@ -256,14 +540,29 @@ int main(int argc, char *argv[])
 				printf("\007Error in case\n");
 				break;
 		}
+		if(nowait)
+		{
+			last_ns = now_ns();
+			if(!first_ns)
+				first_ns = start_ns;
+			if(last_ns - start_ns > max_ns)
+				max_ns = last_ns - start_ns;
+		}
 	}
-	/* we are done - press a key before exiting if needed */
-	if(speed != 3)
+	/* we are done, or quit - press a key before exiting if needed */
+	shm_force_publish(moves,tower);
+	if((speed != 3) && !nowait)
 	{
 		press_msg();
-		getchar();
+		getch();
 	}
-	/* shut down the display and quit */
-	close_display();
+	/*  tell hanoibench, if it's there, how many frames were drawn, the
+	 *  time from the start of the first move to the end of the last,
+	 *  and the slowest move, in nanoseconds
+	 */
+	if(nowait)
+		dprintf(3,"%lu %lu %lu\n",frame_count(),last_ns - first_ns,
+			max_ns);
+	shut_down();		/* shut down the display and quit */
 	return(0);
 }
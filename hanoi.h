@@ -24,10 +24,12 @@
  * History:	8-6-91		Creation
  *		8-7-91		More work
  *		10-29-20	Ported for Linux
+ *		10-19-26	MAXDISKS raised to 64
  *
  */
 
-#define	MAXDISKS	15	/* max number of disks on a stack */
+#define	MAXDISKS	64	/* max number of disks on a stack, the */
+				/* most that 64 bit move numbers allow */
 #define	DEFDISKS	4	/* default number of disks to solve for */
 
 #define	SOURCE	0	/* these define names for the three stacks */
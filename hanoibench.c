@@ -0,0 +1,306 @@
+/*
+ * Name:	hanoibench.c
+ *
+ * Purpose:     This program measures what it costs hanoi to draw. It
+ *		runs "hanoi -b" under a pseudo-terminal of a given size
+ *		and stands in for the terminal by reading everything hanoi
+ *		writes as fast as it can. For each speed and number of
+ *		disks asked for it prints one line with:
+ *
+ *			bytes	total bytes written to the terminal
+ *			writes	write system calls made by hanoi
+ *			frames	refresh() calls, which hanoi -b reports
+ *				on file descriptor 3 when it exits
+ *			fps	frames per second, and
+ *			us/move	microseconds per move, both timed from
+ *				the start of the first move to the end
+ *				of the last, which hanoi -b also reports.
+ *				Starting up and shutting down aren't
+ *				counted.
+ *			max_us	the slowest single move
+ *			user, sys  CPU seconds used by hanoi
+ *
+ *		The lines are tab separated and start with a label, so the
+ *		output of two builds can be pasted together and compared.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	us/move timed by hanoi, added max_us
+ *		10-19-26	fps timed by hanoi too, 64 disks allowed
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define	MAXLIST		32	/* most speeds or disk counts in a list	*/
+
+/* what we found out about one run */
+typedef struct result {
+	unsigned long	bytes;	/* bytes read from the pty	*/
+	long	writes;		/* write syscalls, -1 if unknown */
+	long	frames;		/* refresh() calls, -1 if unknown */
+	double	span;		/* seconds from first move to last, or -1 */
+	double	maxmove;	/* seconds for the slowest move, or -1	*/
+	double	wall;		/* seconds from fork to exit	*/
+	double	user;		/* CPU seconds in user mode	*/
+	double	sys;		/* CPU seconds in the kernel	*/
+	int	status;		/* exit status, or -1 on timeout */
+} result;
+
+/* ===================================================================== */
+
+void usage(void)
+{
+	printf("\nhanoibench - measure the cost of drawing hanoi\n");
+	printf("usage: hanoibench [-p prog] [-r rows] [-c cols] [-s speeds]");
+	printf(" [-d disks]\n\t\t  [-n runs] [-l label] [-t term] ");
+	printf("[-T secs]\n\n");
+	printf("where:\n");
+	printf("\t-p prog   is the hanoi to run (default ./hanoi)\n");
+	printf("\t-r, -c    set the terminal size (default 40x80)\n");
+	printf("\t-s list   is a comma separated list of speeds ");
+	printf("(default 1,2,3,4)\n");
+	printf("\t-d list   is a list of disk counts (default 4,8,12)\n");
+	printf("\t-n runs   repeats each measurement (default 1)\n");
+	printf("\t-l label  starts each line, to tell builds apart\n");
+	printf("\t-t term   is the TERM to give hanoi (default xterm)\n");
+	printf("\t-T secs   kills a run that takes longer (default 600)\n");
+}
+
+/* ===================================================================== */
+
+/* parse a comma separated list of numbers, returns how many there were */
+
+int parse_list(char *s, int *list)
+{
+	int	n = 0;
+	char	*tok;
+
+	for(tok=strtok(s,",");tok && (n<MAXLIST);tok=strtok(NULL,","))
+		list[n++] = atoi(tok);
+	return(n);
+}
+
+/* ===================================================================== */
+
+/* difference between two timespecs in seconds */
+
+double elapsed(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) +
+		(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/* ===================================================================== */
+
+/*  syscalls_written() reads the number of write system calls a process
+ *  has made out of /proc. It has to be called after the process has
+ *  exited but before it is reaped. Returns -1 if it can't be found.
+ */
+
+long syscalls_written(pid_t pid)
+{
+	char	path[64];
+	char	line[128];
+	long	n = -1;
+	FILE	*fp;
+
+	snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+	if((fp = fopen(path, "r")) == NULL)
+		return(-1);
+	while(fgets(line, sizeof(line), fp))
+		if(sscanf(line, "syscw: %ld", &n) == 1)
+			break;
+	fclose(fp);
+	return(n);
+}
+
+/* ===================================================================== */
+
+/*  run_one() runs hanoi once under a rows x cols pty, and reads all of
+ *  its output until it exits.
+ */
+
+void run_one(char *prog, char *term, int rows, int cols, int disks,
+	int speed, int timeout, result *res)
+{
+	struct winsize ws;
+	struct timespec start, now;
+	struct rusage ru;
+	struct pollfd pfd;
+	char	buf[65536];
+	char	dstr[16], sstr[16];
+	siginfo_t info;
+	ssize_t	n;
+	pid_t	pid;
+	int	master;
+	int	status;
+	int	report[2];	/* pipe hanoi reports its frames on */
+	unsigned long span, maxmove; /* and its timings, in nS */
+	FILE	*fp;
+
+	memset(res, 0, sizeof(*res));
+	memset(&ws, 0, sizeof(ws));
+	ws.ws_row = rows;
+	ws.ws_col = cols;
+	snprintf(dstr, sizeof(dstr), "%d", disks);
+	snprintf(sstr, sizeof(sstr), "%d", speed);
+
+	if(pipe(report) < 0)
+	{
+		perror("pipe");
+		exit(1);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if((pid = forkpty(&master, NULL, NULL, &ws)) < 0)
+	{
+		perror("forkpty");
+		exit(1);
+	}
+	if(pid == 0)		/* the child becomes hanoi */
+	{
+		setenv("TERM", term, 1);
+		close(report[0]);
+		if(report[1] != 3)
+		{
+			dup2(report[1], 3);
+			close(report[1]);
+		}
+		execl(prog, prog, "-b", dstr, sstr, (char *)NULL);
+		perror(prog);
+		_exit(127);
+	}
+
+	close(report[1]);
+
+	/* be the terminal: take everything it writes, as fast as we can */
+	pfd.fd = master;
+	pfd.events = POLLIN;
+	for(;;)
+	{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if(elapsed(&start, &now) > timeout)
+		{
+			kill(pid, SIGKILL);
+			res->status = -1;
+			break;
+		}
+		if(poll(&pfd, 1, 1000) <= 0)
+			continue;
+		if((n = read(master, buf, sizeof(buf))) > 0)
+			res->bytes += n;
+		else if((n < 0) && (errno == EINTR))
+			continue;
+		else
+			break;		/* EIO once the child has gone */
+	}
+
+	/* wait for it to finish, but look in /proc before reaping it */
+	waitid(P_PID, pid, &info, WEXITED|WNOWAIT);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	res->writes = syscalls_written(pid);
+	wait4(pid, &status, 0, &ru);
+	close(master);
+	res->frames = -1;
+	res->span = res->maxmove = -1;
+	if((fp = fdopen(report[0], "r")) != NULL)
+	{
+		if(fscanf(fp, "%ld %lu %lu", &res->frames, &span, &maxmove)
+			== 3)
+		{
+			res->span = span / 1e9;
+			res->maxmove = maxmove / 1e9;
+		}
+		else
+			res->frames = -1;
+		fclose(fp);
+	}
+	else
+		close(report[0]);
+
+	res->wall = elapsed(&start, &now);
+	res->user = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6;
+	res->sys = ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+	if(res->status == 0)
+		res->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/* ===================================================================== */
+
+int main(int argc, char *argv[])
+{
+	char	*prog = "./hanoi";
+	char	*term = "xterm";
+	char	*label = "hanoi";
+	char	speedstr[] = "1,2,3,4";
+	char	diskstr[] = "4,8,12";
+	int	speeds[MAXLIST], nspeeds;
+	int	disks[MAXLIST], ndisks;
+	int	rows = 40, cols = 80;
+	int	runs = 1;
+	int	timeout = 600;
+	int	c, i, j, k;
+	unsigned long moves;
+	result	res;
+
+	nspeeds = parse_list(speedstr, speeds);
+	ndisks = parse_list(diskstr, disks);
+	while((c = getopt(argc, argv, "p:r:c:s:d:n:l:t:T:")) != -1)
+	{
+		switch(c)
+		{
+			case 'p': prog = optarg; break;
+			case 'r': rows = atoi(optarg); break;
+			case 'c': cols = atoi(optarg); break;
+			case 's': nspeeds = parse_list(optarg, speeds); break;
+			case 'd': ndisks = parse_list(optarg, disks); break;
+			case 'n': runs = atoi(optarg); break;
+			case 'l': label = optarg; break;
+			case 't': term = optarg; break;
+			case 'T': timeout = atoi(optarg); break;
+			default:
+				usage();
+				exit(1);
+		}
+	}
+
+	printf("label\trows\tcols\tspeed\tdisks\tmoves\tbytes\twrites\t"
+		"frames\twall_s\tfps\tus/move\tmax_us\tuser_s\tsys_s\t"
+		"status\n");
+	for(i=0;i<nspeeds;i++)
+		for(j=0;j<ndisks;j++)
+			for(k=0;k<runs;k++)
+			{
+				run_one(prog, term, rows, cols, disks[j],
+					speeds[i], timeout, &res);
+				moves = (disks[j] >= 64) ? ~0UL :
+					(1UL << disks[j]) - 1;
+				printf("%s\t%d\t%d\t%d\t%d\t%lu\t%lu\t%ld\t"
+					"%ld\t%.3f\t%.1f\t%.2f\t%.1f\t%.3f\t"
+					"%.3f\t%d\n",
+					label, rows, cols, speeds[i], disks[j],
+					moves, res.bytes, res.writes,
+					res.frames, res.wall,
+					((res.frames >= 0) && (res.span > 0)) ?
+						res.frames / res.span : -1.0,
+					(res.span >= 0) ?
+						res.span * 1e6 / moves : -1.0,
+					(res.maxmove >= 0) ?
+						res.maxmove * 1e6 : -1.0,
+					res.user, res.sys, res.status);
+				fflush(stdout);
+			}
+	return(0);
+}
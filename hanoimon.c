@@ -0,0 +1,204 @@
+/*
+ * Name:	hanoimon.c
+ *
+ * Purpose:     This is a small companion program which reads the state
+ *		published by "hanoi -m" from shared memory and prints it.
+ *		It can print a single snapshot, or follow a running solve
+ *		and print a line every so often. It only ever reads the
+ *		segment, so it can't slow down or upset the solver.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	Stop, and clean up, if the solver has died
+ *		10-19-26	Work out the rate here, hanoi doesn't any more
+ *		10-19-26	Read done on its own, it's outside the seqlock
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "hanoi.h"
+#include "shm.h"
+
+/* ===================================================================== */
+
+void usage(void)
+{
+	printf("\nhanoimon - watch a running hanoi\n");
+	printf("usage: hanoimon [-n name] [-f] [-t] [-d msec]\n\n");
+	printf("where:\n");
+	printf("\t-n name  is the shared memory name given to hanoi -m ");
+	printf("(default %s)\n", SHM_DEFNAME);
+	printf("\t-f       follows the run, printing a line every -d mS\n");
+	printf("\t-t       also prints the contents of each tower\n");
+	printf("\t-d msec  is the delay between lines when following ");
+	printf("(default 1000)\n");
+}
+
+/* ===================================================================== */
+
+/* difference between two timespecs in seconds */
+
+double elapsed(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) +
+		(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/* ===================================================================== */
+
+/*  print one snapshot, taken at time now. rate is the moves per second
+ *  since the last one.
+ */
+
+void show_status(hanoi_status *st, int towers, struct timespec *now,
+	double rate)
+{
+	int	i,j;
+	double	pct;
+
+	pct = st->total ? (100.0 * st->moves) / st->total : 0.0;
+	printf("pid %d disks %d move %lu of %lu (%.2f%%) %.0f moves/s "
+		"%.1fs%s\n", st->pid, st->disks, (unsigned long)st->moves,
+		(unsigned long)st->total, pct, rate, elapsed(&st->start, now),
+		st->done ? " done" : "");
+	if(!towers)
+		return;
+	for(i=0;i<3;i++)
+	{
+		printf("  tower %d:", i);
+		for(j=0;j<st->top[i] && j<MAXDISKS;j++)
+			printf(" %d", st->layer[i][j]);
+		printf("\n");
+	}
+}
+
+/* ===================================================================== */
+
+/* alive() returns nonzero if process pid still exists */
+
+int alive(pid_t pid)
+{
+	return((kill(pid, 0) == 0) || (errno == EPERM));
+}
+
+/* ===================================================================== */
+
+int main(int argc, char *argv[])
+{
+	const char *name = SHM_DEFNAME;
+	int	follow = 0;	/* keep printing until the run ends	*/
+	int	towers = 0;	/* print the tower contents too		*/
+	int	delay = 1000;	/* mS between lines when following	*/
+	int	fd;
+	int	c;
+	int	torn;		/* snapshot taken while the solver was writing */
+	int	first = 1;	/* no snapshot taken yet		*/
+	int	ret = 0;
+	volatile hanoi_status *seg;
+	hanoi_status st;
+	struct timespec now;	/* when this snapshot was taken		*/
+	struct timespec then;	/* and the one before			*/
+	uint64_t last;		/* move number in the one before	*/
+	double	secs;
+	double	rate;
+
+	while((c = getopt(argc, argv, "n:ftd:")) != -1)
+	{
+		switch(c)
+		{
+			case 'n':
+				name = optarg;
+				break;
+			case 'f':
+				follow = 1;
+				break;
+			case 't':
+				towers = 1;
+				break;
+			case 'd':
+				delay = atoi(optarg);
+				break;
+			default:
+				usage();
+				exit(1);
+		}
+	}
+	if(delay < 1)
+		delay = 1;
+
+	if((fd = shm_open(name, O_RDONLY, 0)) < 0)
+	{
+		perror(name);
+		exit(1);
+	}
+	seg = mmap(NULL, sizeof(hanoi_status), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(seg == MAP_FAILED)
+	{
+		perror(name);
+		exit(1);
+	}
+	if((__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != SHM_MAGIC) ||
+		(seg->version != SHM_VERSION))
+	{
+		printf("%s is not a hanoi status segment\n", name);
+		exit(1);
+	}
+
+	do
+	{
+		torn = shm_read_status(seg, &st);
+		st.done = __atomic_load_n(&seg->done, __ATOMIC_ACQUIRE);
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if(st.done)		/* stamped by the last publish */
+			now = st.stamp;
+		/*  hanoi doesn't time its moves, it's too expensive, so the
+		 *  rate is worked out here: since the start the first time,
+		 *  and since the last snapshot after that.
+		 */
+		if(first)
+		{
+			then = st.start;
+			last = 0;
+		}
+		secs = elapsed(&then, &now);
+		rate = 0.0;
+		if((secs > 0) && (st.moves >= last))	/* not a seek back */
+			rate = (st.moves - last) / secs;
+		then = now;
+		last = st.moves;
+		first = 0;
+		if(!torn)
+			show_status(&st, towers, &now, rate);
+		fflush(stdout);
+		if(st.done)
+		{
+			if(torn)
+				printf("hanoi (pid %d) stopped part way through "
+					"an update\n", st.pid);
+			break;
+		}
+		/*  a solver that was killed never sets done, so without this
+		 *  we would print the same move forever. It can't remove the
+		 *  segment either, so we do.
+		 */
+		if(!alive(st.pid))
+		{
+			printf("hanoi (pid %d) has gone away without finishing\n",
+				st.pid);
+			shm_unlink(name);
+			ret = 1;
+			break;
+		}
+		if(follow)
+			usleep(delay * 1000);
+	} while(follow);
+
+	munmap((void *)seg, sizeof(hanoi_status));
+	return(ret);
+}
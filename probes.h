@@ -0,0 +1,54 @@
+/*
+ * Name:	probes.h
+ *
+ * Purpose:     This file defines the static tracepoints (USDT probes)
+ *		in hanoi, so that a running copy can be looked at with perf
+ *		or bpftrace without building it again. A probe is a single
+ *		nop instruction until something attaches to it.
+ *
+ *		The probes use <sys/sdt.h> from systemtap. If that isn't
+ *		installed, or NO_SDT is defined (make CPPFLAGS=-DNO_SDT),
+ *		the macros below do nothing and hanoi builds as before.
+ *
+ *		All of the probes are in the "hanoi" provider:
+ *
+ *		move(moves, size, from, to)	every move made
+ *		batch(moves)			every BATCH moves
+ *		put_disk_entry(tower, height, size), put_disk_return()
+ *		remove_disk_entry(tower, height), remove_disk_return()
+ *		float_disk_entry(from, to, fr_h, to_h), float_disk_return()
+ *		show_towers_entry(), show_towers_return()
+ *		refresh_entry(frame), refresh_return(frame)
+ *		resize(lines, cols)		after the screen is laid out again
+ *		publish(moves)			shared memory updated
+ *		checkpoint(chunk, bytes)	a trace chunk is on disk
+ *
+ *		See scripts/ for bpftrace examples.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	NO_SDT goes in CPPFLAGS
+ *
+ */
+
+#define	BATCH	65536		/* moves between batch probes, a power of 2 */
+
+#if !defined(NO_SDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define	HAVE_SDT	1
+#endif
+#endif
+
+#ifdef HAVE_SDT
+#define	PROBE0(name)		DTRACE_PROBE(hanoi,name)
+#define	PROBE1(name,a)		DTRACE_PROBE1(hanoi,name,a)
+#define	PROBE2(name,a,b)	DTRACE_PROBE2(hanoi,name,a,b)
+#define	PROBE3(name,a,b,c)	DTRACE_PROBE3(hanoi,name,a,b,c)
+#define	PROBE4(name,a,b,c,d)	DTRACE_PROBE4(hanoi,name,a,b,c,d)
+#else
+#define	PROBE0(name)		do {} while(0)
+#define	PROBE1(name,a)		do {} while(0)
+#define	PROBE2(name,a,b)	do {} while(0)
+#define	PROBE3(name,a,b,c)	do {} while(0)
+#define	PROBE4(name,a,b,c,d)	do {} while(0)
+#endif
@@ -0,0 +1,211 @@
+/*
+ * Name:	shm.c
+ *
+ * Purpose:     This file contains the routines which publish the state
+ *		of a running solve into POSIX shared memory. See shm.h for
+ *		the layout of the segment and the locking rules.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	Added the publish probe
+ *		10-19-26	Close always leaves seq even, readers give up
+ *		10-19-26	Per move publish only stores what changed
+ *		10-19-26	Close leaves a torn snapshot torn
+ *
+ */
+
+#include "hanoi.h"
+#include "shm.h"
+#include "probes.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define	SPINS		100	/* tries before a reader starts sleeping */
+#define	TRIES		1100	/* tries before it gives up (about 1s)	*/
+
+static	hanoi_status	*status;	/* the mapped segment, or NULL	*/
+static	char	shm_name[256];		/* so we can unlink it later	*/
+static	int	every;			/* moves between publishes	*/
+static	int	countdown;		/* moves left until next publish */
+static	uint32_t seq;			/* our copy of status->seq	*/
+static	int	low[3];			/* lowest layer of each tower	*/
+					/* changed since the last publish */
+
+/* ==================================================================== */
+
+/*  shm_open_status() creates and maps the segment, and fills in the
+ *  fields which stay the same for the whole run.
+ */
+
+int shm_open_status(const char *name, int disks, int speed, int interval)
+{
+	int	fd;
+
+	if(interval < 1)
+		interval = 1;
+	every = interval;
+	if((fd = shm_open(name, O_CREAT|O_RDWR|O_TRUNC, 0644)) < 0)
+	{
+		perror(name);
+		return(-1);
+	}
+	if(ftruncate(fd, sizeof(hanoi_status)) < 0)
+	{
+		perror(name);
+		close(fd);
+		shm_unlink(name);
+		return(-1);
+	}
+	status = mmap(NULL, sizeof(hanoi_status), PROT_READ|PROT_WRITE,
+		MAP_SHARED, fd, 0);
+	close(fd);
+	if(status == MAP_FAILED)
+	{
+		perror(name);
+		status = NULL;
+		shm_unlink(name);
+		return(-1);
+	}
+	strncpy(shm_name, name, sizeof(shm_name)-1);
+
+	/* the segment is zero filled, so seq starts out even */
+	status->version = SHM_VERSION;
+	status->pid = getpid();
+	status->disks = disks;
+	status->speed = speed;
+	status->interval = interval;
+	status->total = (disks >= 64) ? ~0UL : (1UL << disks) - 1;
+	clock_gettime(CLOCK_MONOTONIC, &status->start);
+	status->stamp = status->start;
+	countdown = interval;
+	seq = 0;
+	low[0] = low[1] = low[2] = 0;
+	/* readers check the magic number last, so set it last */
+	__atomic_store_n(&status->magic, SHM_MAGIC, __ATOMIC_RELEASE);
+	return(0);
+}
+
+/* ==================================================================== */
+
+/*  publish() writes a new snapshot, copying each tower from the lowest
+ *  layer that has changed. The sequence number is made odd before
+ *  anything is touched, and even again after the last store, so readers
+ *  can tell when they raced with us. On x86 the fences cost nothing;
+ *  they only stop the compiler moving the stores around.
+ */
+
+static inline void publish(unsigned long moves, stack tower[])
+{
+	int	i,j;
+
+	countdown = every;
+	__atomic_store_n(&status->seq, ++seq, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	status->moves = moves;
+	status->publishes++;
+	for(i=0;i<3;i++)
+	{
+		for(j=low[i];j<tower[i].top;j++)
+			status->layer[i][j] = tower[i].layer[j];
+		status->top[i] = tower[i].top;
+		low[i] = MAXDISKS;
+	}
+
+	__atomic_store_n(&status->seq, ++seq, __ATOMIC_RELEASE);
+	PROBE1(publish,moves);
+}
+
+/* ==================================================================== */
+
+/*  shm_force_publish() copies everything, since after a seek any layer
+ *  may have changed, and stamps the time.
+ */
+
+void shm_force_publish(unsigned long moves, stack tower[])
+{
+	if(!status)
+		return;
+	clock_gettime(CLOCK_MONOTONIC, &status->stamp);
+	low[0] = low[1] = low[2] = 0;
+	publish(moves, tower);
+}
+
+/* ==================================================================== */
+
+/*  shm_publish() is called on every move, so it has to be cheap. A
+ *  move takes the top off one tower and puts it on another, so all it
+ *  has to note is how far down each of those has changed. Every
+ *  interval moves just those layers are copied, which is one disk when
+ *  interval is 1. There is no clock and no arithmetic; readers work out
+ *  rates from their own clock and the move number.
+ */
+
+void shm_publish(unsigned long moves, stack tower[], int fr, int to)
+{
+	if(!status)
+		return;
+	if(tower[fr].top < low[fr])
+		low[fr] = tower[fr].top;
+	if(tower[to].top - 1 < low[to])
+		low[to] = tower[to].top - 1;
+	if(--countdown > 0)
+		return;
+	publish(moves, tower);
+}
+
+/* ==================================================================== */
+
+/*  shm_close_status() sets done for anybody still looking, then removes
+ *  the segment name. Readers which already have it mapped keep their
+ *  copy until they unmap it.
+ *
+ *  This is called from the ^C handler too, which may have interrupted
+ *  a publish with seq odd and the towers half copied. That snapshot
+ *  must stay torn, so done is stored on its own, outside the sequence
+ *  lock, and seq is left alone.
+ */
+
+void shm_close_status(void)
+{
+	if(!status)
+		return;
+	__atomic_store_n(&status->done, 1, __ATOMIC_RELEASE);
+	munmap(status, sizeof(hanoi_status));
+	status = NULL;
+	shm_unlink(shm_name);
+}
+
+/* ==================================================================== */
+
+/*  shm_read_status() copies the segment, and tries again if the writer
+ *  was in the middle of an update. An update takes nanoseconds, so it
+ *  spins at first, then sleeps a millisecond between tries, and gives
+ *  up if seq stays odd for about a second, since that means the writer
+ *  died part way through.
+ */
+
+int shm_read_status(const volatile hanoi_status *src, hanoi_status *dst)
+{
+	uint32_t before, after;
+	int	tries;
+
+	for(tries=0;tries<TRIES;tries++)
+	{
+		if(tries >= SPINS)
+			usleep(1000);
+		before = __atomic_load_n(&src->seq, __ATOMIC_ACQUIRE);
+		if(before & 1)		/* writer is busy */
+			continue;
+		memcpy(dst, (const void *)src, sizeof(hanoi_status));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		after = __atomic_load_n(&src->seq, __ATOMIC_RELAXED);
+		if(before == after)
+			return(0);
+	}
+	memcpy(dst, (const void *)src, sizeof(hanoi_status));
+	return(-1);
+}
@@ -0,0 +1,91 @@
+/*
+ * Name:	shm.h
+ *
+ * Purpose:     This is the header file for the shared memory status
+ *		functions in shm.c. While the solver runs, it can publish
+ *		the move number, the three towers and some throughput
+ *		counters into a POSIX shared memory segment, so that other
+ *		programs (see hanoimon.c) can watch a run without touching
+ *		the screen.
+ *
+ *		The segment is protected by a sequence lock. The writer
+ *		makes the sequence number odd while it updates the data
+ *		and even again when it is done. A reader copies the data
+ *		and retries if the sequence number was odd or changed while
+ *		it was copying. Readers never block the writer, and any
+ *		number of them may watch at once.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	shm_read_status gives up on a dead writer
+ *		10-19-26	Dropped rate, readers work it out themselves
+ *		10-19-26	done is set outside the sequence lock
+ *
+ */
+
+#include <stdint.h>
+#include <time.h>
+
+#define	SHM_DEFNAME	"/hanoi"	/* default segment name		*/
+#define	SHM_MAGIC	0x48414e4fU	/* "HANO", marks a valid segment */
+#define	SHM_VERSION	3		/* bumped if the layout changes	*/
+#define	SHM_DEFINTERVAL	1		/* default moves between publishes */
+
+/* the layout of the shared memory segment */
+typedef struct hanoi_status {
+	uint32_t magic;		/* SHM_MAGIC once the segment is set up	*/
+	uint32_t version;	/* SHM_VERSION				*/
+	uint32_t seq;		/* sequence lock, odd while writing	*/
+	int32_t	pid;		/* process id of the solver		*/
+	int32_t	disks;		/* number of disks being solved		*/
+	int32_t	speed;		/* display speed selected		*/
+	int32_t	done;		/* set when the solver exits. Not under	*/
+				/* seq, so read it with an atomic load	*/
+	int32_t	interval;	/* moves between publishes		*/
+	uint64_t moves;		/* the current move number		*/
+	uint64_t total;		/* moves needed to finish (2^n - 1)	*/
+	uint64_t publishes;	/* number of times we have published	*/
+	struct timespec start;	/* CLOCK_MONOTONIC time of the first move */
+	struct timespec stamp;	/* CLOCK_MONOTONIC time of the last forced */
+				/* publish (not updated on every move)	*/
+	int32_t	top[3];		/* number of disks on each tower	*/
+	uint8_t	layer[3][MAXDISKS]; /* disk sizes, bottom of tower first */
+} hanoi_status;
+
+/*  shm_open_status() creates the named segment and fills in the parts
+ *  that don't change during a run. interval is the number of moves
+ *  between publishes. Returns 0 on success, -1 if the segment could
+ *  not be created.
+ */
+
+int shm_open_status(const char *name, int disks, int speed, int interval);
+
+/*  shm_publish() copies the move number and the parts of the towers
+ *  which have changed into the segment. fr and to are the towers the
+ *  move just made went from and to. It only does real work every
+ *  interval moves, and then only stores what changed, so it is cheap
+ *  enough to call on every move. It does nothing if the segment was
+ *  never opened.
+ */
+
+void shm_publish(unsigned long moves, stack tower[], int fr, int to);
+
+/*  shm_force_publish() publishes regardless of the interval. This is
+ *  used after a seek, at the end of a run, and so on.
+ */
+
+void shm_force_publish(unsigned long moves, stack tower[]);
+
+/*  shm_close_status() marks the run as done, unmaps the segment and
+ *  removes its name.
+ */
+
+void shm_close_status(void);
+
+/*  shm_read_status() is used by readers. It takes a consistent snapshot
+ *  of the mapped segment at src and copies it to dst, retrying while
+ *  the writer is busy. Returns 0, or -1 if the writer never finished
+ *  its update (it was killed part way through), in which case dst is
+ *  copied anyway but may be inconsistent.
+ */
+
+int shm_read_status(const volatile hanoi_status *src, hanoi_status *dst);
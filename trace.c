@@ -0,0 +1,681 @@
+/*
+ * Name:	trace.c
+ *
+ * Purpose:     This file writes trace files (see trace.h for the format).
+ *
+ *		Any move can be worked out from its number alone (see
+ *		move_code below), so the file is cut into chunks and a
+ *		pool of generator threads fills them in parallel, each into
+ *		its own aligned buffer. The main thread writes the filled
+ *		buffers out with O_DIRECT, through io_uring when the kernel
+ *		has it, or with plain pwrite() when it doesn't. There are a
+ *		fixed number of buffers, TRACE_BUFS for each thread, so the
+ *		memory used is bounded, and while some buffers are being
+ *		written the generators carry on filling the others.
+ *
+ *		Writes can finish out of order, so after a crash the last
+ *		"depth" chunks of the file may have holes in them. No chunk
+ *		is started more than depth chunks past the lowest one not
+ *		yet written, so everything before those is known to be
+ *		there. A resumed run cuts them off and writes them again.
+ *
+ * History:	10-19-26	Creation
+ *		10-19-26	Added the checkpoint probe
+ *		10-19-26	A failed io_uring wait is fatal, no leaks on errors
+ *		10-19-26	Keep the chunks in flight within depth of each other
+ *
+ */
+
+#define	_GNU_SOURCE		/* for O_DIRECT */
+#include "hanoi.h"
+#include "trace.h"
+#include "probes.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define	HAVE_URING	1
+#endif
+#endif
+
+/* the states a buffer goes through */
+#define	FREE	0	/* waiting for a generator			*/
+#define	FILLING	1	/* a generator is working on it			*/
+#define	READY	2	/* filled, waiting to be written		*/
+#define	WRITING	3	/* handed to the kernel				*/
+
+/* one buffer, and the chunk of the file it holds */
+typedef struct slot {
+	uint8_t	*buf;		/* TRACE_CHUNK bytes, TRACE_ALIGN aligned */
+	uint64_t chunk;		/* which chunk of the file		*/
+	size_t	len;		/* bytes of move codes in it		*/
+	int	state;		/* FREE, FILLING, READY or WRITING	*/
+} slot;
+
+/* everything the generator threads share with the writer */
+static struct {
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;	/* signalled whenever a slot changes state */
+	slot	*slots;
+	int	nslots;
+	uint64_t next;		/* next chunk to be generated		*/
+	uint64_t nchunks;	/* chunks in the whole file		*/
+	uint64_t moves;		/* moves in the whole file		*/
+	uint64_t bytes;		/* bytes of move codes in the file	*/
+	uint8_t	codes[2][3];	/* move code by disk parity and count mod 3 */
+} gen;
+
+/* ==================================================================== */
+
+/* difference between two timespecs in seconds */
+
+static double elapsed(struct timespec *from, struct timespec *to)
+{
+	return (to->tv_sec - from->tv_sec) +
+		(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/* ==================================================================== */
+
+/*  move_code() returns the 4 bit code for move number m. The disk moved
+ *  is one more than the number of trailing zeros in m, and this is the
+ *  (m >> disk)'th time it has moved. Like set_position() in hanoi.c,
+ *  that count mod 3 and which way the disk travels give the towers,
+ *  and codes[][] has those worked out already.
+ */
+
+static inline uint8_t move_code(uint64_t m)
+{
+	int	z = __builtin_ctzl(m);
+
+	return(gen.codes[!(z & 1)][((m >> z) >> 1) % 3]);
+}
+
+/* ==================================================================== */
+
+/* fill_chunk() fills a buffer with the move codes for its chunk */
+
+static void fill_chunk(slot *s)
+{
+	uint64_t first;		/* first byte of the chunk in the file */
+	uint64_t m;		/* move number, always odd */
+	size_t	b;
+	int	r;		/* times the small disk has moved, mod 3 */
+
+	first = s->chunk * TRACE_CHUNK;
+	s->len = (gen.bytes - first < TRACE_CHUNK) ?
+		gen.bytes - first : TRACE_CHUNK;
+	m = first*2 + 1;
+	r = (m >> 1) % 3;
+	/*  the odd moves are all the small disk, so the low half of each
+	 *  byte just goes round the same three codes
+	 */
+	for(b=0;b<s->len;b++,m+=2)
+	{
+		s->buf[b] = gen.codes[1][r] |
+			((m < gen.moves) ? move_code(m+1) << 4 : 0);
+		if(++r == 3)
+			r = 0;
+	}
+	/* the last chunk is padded out for O_DIRECT, then cut off */
+	for(;b%TRACE_ALIGN;b++)
+		s->buf[b] = 0;
+}
+
+/* ==================================================================== */
+
+/*  unwritten() returns the lowest chunk not yet written. Every chunk
+ *  below gen.next that isn't in a buffer has been written, so it is the
+ *  lowest chunk held in a buffer, or gen.next if none are. Called with
+ *  gen.lock held.
+ */
+
+static uint64_t unwritten(void)
+{
+	uint64_t low;
+	int	i;
+
+	low = gen.next;
+	for(i=0;i<gen.nslots;i++)
+		if((gen.slots[i].state != FREE) && (gen.slots[i].chunk < low))
+			low = gen.slots[i].chunk;
+	return(low);
+}
+
+/*  generator() is the body of each generator thread. It takes the next
+ *  chunk and a free buffer, fills it, and marks it ready for writing,
+ *  until there are no chunks left. It waits rather than start a chunk
+ *  more than depth (one per buffer) past the lowest unwritten one, so
+ *  one slow write can't leave holes further back than a resume redoes.
+ */
+
+static void *generator(void *arg)
+{
+	slot	*s;
+	int	i;
+
+	for(;;)
+	{
+		pthread_mutex_lock(&gen.lock);
+		for(s=NULL;gen.next < gen.nchunks;)
+		{
+			for(i=0;i<gen.nslots;i++)
+				if(gen.slots[i].state == FREE)
+					break;
+			if((i < gen.nslots) &&
+				(gen.next < unwritten() + gen.nslots))
+			{
+				s = &gen.slots[i];
+				break;
+			}
+			pthread_cond_wait(&gen.cond, &gen.lock);
+		}
+		if(!s)		/* nothing left to do */
+		{
+			pthread_mutex_unlock(&gen.lock);
+			return(NULL);
+		}
+		s->state = FILLING;
+		s->chunk = gen.next++;
+		pthread_mutex_unlock(&gen.lock);
+
+		fill_chunk(s);
+
+		pthread_mutex_lock(&gen.lock);
+		s->state = READY;
+		pthread_cond_broadcast(&gen.cond);
+		pthread_mutex_unlock(&gen.lock);
+	}
+}
+
+/* ==================================================================== */
+
+#ifdef HAVE_URING
+
+/*  A small io_uring, set up with the raw system calls so that we don't
+ *  need liburing. It only ever does writes.
+ */
+
+static struct {
+	int	fd;			/* -1 if we aren't using io_uring */
+	unsigned *sq_tail, *sq_mask, *sq_array;
+	unsigned *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	void	*sq_ptr, *cq_ptr;
+	size_t	sq_size, cq_size, sqe_size;
+} ring = { -1 };
+
+/* ring_init() sets up a ring with room for entries writes */
+
+static int ring_init(unsigned entries)
+{
+	struct io_uring_params p;
+	int	fd;
+
+	memset(&p, 0, sizeof(p));
+	if((fd = syscall(__NR_io_uring_setup, entries, &p)) < 0)
+		return(-1);
+	ring.sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	ring.cq_size = p.cq_off.cqes +
+		p.cq_entries * sizeof(struct io_uring_cqe);
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if(ring.cq_size > ring.sq_size)
+			ring.sq_size = ring.cq_size;
+		ring.cq_size = ring.sq_size;
+	}
+	ring.sq_ptr = mmap(NULL, ring.sq_size, PROT_READ|PROT_WRITE,
+		MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if(ring.sq_ptr == MAP_FAILED)
+	{
+		close(fd);
+		return(-1);
+	}
+	if(p.features & IORING_FEAT_SINGLE_MMAP)
+		ring.cq_ptr = ring.sq_ptr;
+	else if((ring.cq_ptr = mmap(NULL, ring.cq_size,
+		PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, fd,
+		IORING_OFF_CQ_RING)) == MAP_FAILED)
+	{
+		munmap(ring.sq_ptr, ring.sq_size);
+		close(fd);
+		return(-1);
+	}
+	ring.sqe_size = p.sq_entries * sizeof(struct io_uring_sqe);
+	if((ring.sqes = mmap(NULL, ring.sqe_size, PROT_READ|PROT_WRITE,
+		MAP_SHARED|MAP_POPULATE, fd, IORING_OFF_SQES)) == MAP_FAILED)
+	{
+		if(ring.cq_ptr != ring.sq_ptr)
+			munmap(ring.cq_ptr, ring.cq_size);
+		munmap(ring.sq_ptr, ring.sq_size);
+		close(fd);
+		return(-1);
+	}
+	ring.sq_tail = (unsigned *)((char *)ring.sq_ptr + p.sq_off.tail);
+	ring.sq_mask = (unsigned *)((char *)ring.sq_ptr + p.sq_off.ring_mask);
+	ring.sq_array = (unsigned *)((char *)ring.sq_ptr + p.sq_off.array);
+	ring.cq_head = (unsigned *)((char *)ring.cq_ptr + p.cq_off.head);
+	ring.cq_tail = (unsigned *)((char *)ring.cq_ptr + p.cq_off.tail);
+	ring.cq_mask = (unsigned *)((char *)ring.cq_ptr + p.cq_off.ring_mask);
+	ring.cqes = (struct io_uring_cqe *)((char *)ring.cq_ptr +
+		p.cq_off.cqes);
+	ring.fd = fd;
+	return(0);
+}
+
+/* ring_exit() tears the ring down again */
+
+static void ring_exit(void)
+{
+	if(ring.fd < 0)
+		return;
+	munmap(ring.sqes, ring.sqe_size);
+	if(ring.cq_ptr != ring.sq_ptr)
+		munmap(ring.cq_ptr, ring.cq_size);
+	munmap(ring.sq_ptr, ring.sq_size);
+	close(ring.fd);
+	ring.fd = -1;
+}
+
+/* ring_write() queues a write and tells the kernel about it */
+
+static int ring_write(int fd, void *buf, unsigned len, uint64_t off,
+	uint64_t data)
+{
+	struct io_uring_sqe *sqe;
+	unsigned tail, idx;
+
+	tail = *ring.sq_tail;
+	idx = tail & *ring.sq_mask;
+	sqe = &ring.sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = fd;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->user_data = data;
+	ring.sq_array[idx] = idx;
+	__atomic_store_n(ring.sq_tail, tail+1, __ATOMIC_RELEASE);
+	return(syscall(__NR_io_uring_enter, ring.fd, 1, 0, 0, NULL, 0) == 1
+		? 0 : -1);
+}
+
+/*  ring_reap() gets one finished write, waiting for it if wait is set.
+ *  Returns 1 if it got one, 0 if there wasn't one, or -1 if waiting
+ *  failed.
+ */
+
+static int ring_reap(uint64_t *data, int *res, int wait)
+{
+	struct io_uring_cqe *cqe;
+	unsigned head;
+
+	for(;;)
+	{
+		head = *ring.cq_head;
+		if(head != __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE))
+			break;
+		if(!wait)
+			return(0);
+		if((syscall(__NR_io_uring_enter, ring.fd, 0, 1,
+			IORING_ENTER_GETEVENTS, NULL, 0) < 0) && (errno != EINTR))
+			return(-1);
+	}
+	cqe = &ring.cqes[head & *ring.cq_mask];
+	*data = cqe->user_data;
+	*res = cqe->res;
+	__atomic_store_n(ring.cq_head, head+1, __ATOMIC_RELEASE);
+	return(1);
+}
+
+#endif
+
+/* ==================================================================== */
+
+/*  write_all() writes len bytes at off with pwrite(). If O_DIRECT is
+ *  refused part way through, it turns it off and carries on.
+ */
+
+static int write_all(int fd, void *buf, size_t len, uint64_t off)
+{
+	ssize_t	n;
+	size_t	done = 0;
+
+	while(done < len)
+	{
+		n = pwrite(fd, (char *)buf + done, len - done, off + done);
+		if((n < 0) && (errno == EINTR))
+			continue;
+		if((n < 0) && (errno == EINVAL) &&
+			(fcntl(fd, F_GETFL) & O_DIRECT))
+		{
+			fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+			continue;
+		}
+		if(n <= 0)
+			return(-1);
+		done += n;
+	}
+	return(0);
+}
+
+/* ==================================================================== */
+
+/*  open_trace() opens the file, with O_DIRECT if the file system will
+ *  let us.
+ */
+
+static int open_trace(const char *name, int flags)
+{
+	int	fd;
+
+	if((fd = open(name, flags|O_DIRECT, 0644)) >= 0)
+		return(fd);
+	if(errno != EINVAL)
+		return(-1);
+	return(open(name, flags, 0644));
+}
+
+/* ==================================================================== */
+
+/*  finish_write() is called when a buffer has been written, or partly
+ *  written if res is short. It writes any part the kernel didn't, gives
+ *  the buffer back to the generators and reports progress now and then.
+ */
+
+static struct timespec	start, last;	/* when we started, last report */
+static uint64_t	done;			/* bytes written by this run	*/
+
+static void finish_write(const char *name, int fd, slot *s, size_t res)
+{
+	struct timespec now;
+	size_t	wlen;
+	double	secs;
+
+	wlen = (s->len + TRACE_ALIGN - 1) & ~(TRACE_ALIGN - 1);
+	if((res < wlen) && (write_all(fd, s->buf + res, wlen - res,
+		TRACE_HDRSIZE + s->chunk * TRACE_CHUNK + res) < 0))
+	{
+		perror(name);
+		exit(1);
+	}
+
+	pthread_mutex_lock(&gen.lock);
+	s->state = FREE;
+	pthread_cond_broadcast(&gen.cond);
+	pthread_mutex_unlock(&gen.lock);
+	done += s->len;
+	PROBE2(checkpoint,s->chunk,s->len);
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if(elapsed(&last, &now) >= 2.0)
+	{
+		secs = elapsed(&start, &now);
+		fprintf(stderr, "%s: chunk %lu of %lu  %.1f MB/s  %.3g moves/s\n",
+			name, (unsigned long)s->chunk+1,
+			(unsigned long)gen.nchunks, done / secs / 1e6,
+			2.0 * done / secs);
+		last = now;
+	}
+}
+
+/* ==================================================================== */
+
+/*  write_trace() sets everything up, starts the generators, and then
+ *  spends its time handing full buffers to the kernel and handing
+ *  written buffers back to the generators.
+ */
+
+int write_trace(const char *name, int disks, int threads, int resume)
+{
+	trace_header *hdr;	/* aligned, so it can be written direct */
+	pthread_t *tids;
+	struct timespec now;
+	struct stat st;
+	uint64_t first;		/* first chunk this run writes */
+	uint64_t left;		/* chunks still to be written */
+	slot	*s;
+	double	secs;
+	int	fd, dir, step, p, r, i;
+	int	inflight = 0;	/* writes handed to io_uring */
+	int	uring = 0;	/* using io_uring rather than pwrite */
+	int	ret = 0;
+#ifdef HAVE_URING
+	uint64_t data;
+	int	res, wait, got;
+#endif
+
+	if(threads < 1)
+		threads = 1;
+
+	/* work out the code for each move, as in set_position() */
+	dir = (disks & 1) ? 1 : 2;
+	for(p=0;p<2;p++)
+	{
+		step = p ? dir : 3 - dir;	/* p is 1 for odd disks */
+		for(r=0;r<3;r++)
+			gen.codes[p][r] = (((r*step) % 3) << 2) |
+				(((r+1)*step) % 3);
+	}
+	gen.moves = (disks >= 64) ? ~0UL : (1UL << disks) - 1;
+	gen.bytes = gen.moves/2 + (gen.moves & 1);
+	gen.nchunks = (gen.bytes + TRACE_CHUNK - 1) / TRACE_CHUNK;
+	gen.nslots = threads * TRACE_BUFS;
+
+	if(posix_memalign((void **)&hdr, TRACE_ALIGN, TRACE_HDRSIZE))
+	{
+		printf("malloc failure 1 in write_trace()\n");
+		exit(1);
+	}
+	memset(hdr, 0, TRACE_HDRSIZE);
+
+	/* open the file, and if resuming, find out how far it got */
+	first = 0;
+	if(resume && ((fd = open_trace(name, O_RDWR)) >= 0))
+	{
+		if((pread(fd, hdr, TRACE_HDRSIZE, 0) != TRACE_HDRSIZE) ||
+			memcmp(hdr->magic, TRACE_MAGIC, 8) ||
+			(hdr->version != TRACE_VERSION) ||
+			(hdr->disks != disks) || (hdr->chunk != TRACE_CHUNK))
+		{
+			fprintf(stderr, "%s is not a trace for %d disks\n",
+				name, disks);
+			close(fd);
+			free(hdr);
+			return(-1);
+		}
+		if(hdr->complete)
+		{
+			fprintf(stderr, "%s is already complete\n", name);
+			close(fd);
+			free(hdr);
+			return(0);
+		}
+		fstat(fd, &st);
+		if(st.st_size > TRACE_HDRSIZE)
+			first = (st.st_size - TRACE_HDRSIZE) / TRACE_CHUNK;
+		/* the last depth chunks may have holes, so redo them */
+		first = (first > hdr->depth) ? first - hdr->depth : 0;
+		if(ftruncate(fd, TRACE_HDRSIZE + first * TRACE_CHUNK) < 0)
+		{
+			perror(name);
+			close(fd);
+			free(hdr);
+			return(-1);
+		}
+	}
+	else if((fd = open_trace(name, O_RDWR|O_CREAT|O_TRUNC)) < 0)
+	{
+		perror(name);
+		free(hdr);
+		return(-1);
+	}
+	memcpy(hdr->magic, TRACE_MAGIC, 8);
+	hdr->version = TRACE_VERSION;
+	hdr->disks = disks;
+	hdr->moves = gen.moves;
+	hdr->bytes = gen.bytes;
+	hdr->chunk = TRACE_CHUNK;
+	hdr->depth = gen.nslots;
+	hdr->complete = 0;
+	if(write_all(fd, hdr, TRACE_HDRSIZE, 0) < 0)
+	{
+		perror(name);
+		close(fd);
+		free(hdr);
+		return(-1);
+	}
+
+	/* set up the buffers */
+	if(((gen.slots = calloc(gen.nslots, sizeof(slot))) == NULL) ||
+		((tids = calloc(threads, sizeof(pthread_t))) == NULL))
+	{
+		printf("malloc failure 2 in write_trace()\n");
+		exit(1);
+	}
+	for(i=0;i<gen.nslots;i++)
+		if(posix_memalign((void **)&gen.slots[i].buf, TRACE_ALIGN,
+			TRACE_CHUNK))
+		{
+			printf("malloc failure 3 in write_trace()\n");
+			exit(1);
+		}
+#ifdef HAVE_URING
+	uring = (ring_init(gen.nslots) == 0);
+#endif
+	fprintf(stderr, "%s: %lu moves, %lu bytes, %d threads, %d MB "
+		"buffered, %s%s\n", name, (unsigned long)gen.moves,
+		(unsigned long)gen.bytes, threads,
+		(gen.nslots * TRACE_CHUNK) >> 20,
+		uring ? "io_uring" : "pwrite",
+		(fcntl(fd, F_GETFL) & O_DIRECT) ? ", O_DIRECT" : "");
+	if(first)
+		fprintf(stderr, "%s: resuming at move %lu\n", name,
+			(unsigned long)(first * TRACE_CHUNK * 2 + 1));
+
+	/* start the generators */
+	pthread_mutex_init(&gen.lock, NULL);
+	pthread_cond_init(&gen.cond, NULL);
+	gen.next = first;
+	for(i=0;i<threads;i++)
+		pthread_create(&tids[i], NULL, generator, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	last = start;
+	for(left=gen.nchunks-first;left;)
+	{
+		/* find a full buffer, or wait for one if nothing is going */
+		pthread_mutex_lock(&gen.lock);
+		for(s=NULL;;)
+		{
+			for(i=0;i<gen.nslots;i++)
+				if(gen.slots[i].state == READY)
+					break;
+			if(i < gen.nslots)
+			{
+				s = &gen.slots[i];
+				s->state = WRITING;
+				break;
+			}
+			if(inflight)
+				break;
+			pthread_cond_wait(&gen.cond, &gen.lock);
+		}
+		pthread_mutex_unlock(&gen.lock);
+
+		/* hand it to io_uring, or write it ourselves */
+		if(s)
+		{
+#ifdef HAVE_URING
+			if(uring && (ring_write(fd, s->buf, (s->len +
+				TRACE_ALIGN - 1) & ~(TRACE_ALIGN - 1),
+				TRACE_HDRSIZE + s->chunk * TRACE_CHUNK,
+				s - gen.slots) == 0))
+				inflight++;
+			else
+#endif
+			{
+				/* a failed submit is never retried */
+				uring = 0;
+				finish_write(name, fd, s, 0);
+				left--;
+			}
+		}
+
+#ifdef HAVE_URING
+		/*  give back every buffer whose write has finished, but
+		 *  only wait for one if there was nothing new to hand over
+		 */
+		for(wait=!s;inflight;wait=0)
+		{
+			/*  if we can't wait for the writes in flight, their
+			 *  buffers never come back, so give up. What was
+			 *  written can be carried on from with -r.
+			 */
+			if((got = ring_reap(&data,&res,wait)) < 0)
+			{
+				perror(name);
+				exit(1);
+			}
+			if(!got)
+				break;
+			inflight--;
+			if(res < 0)
+			{
+				/*  this kernel or file system won't do it
+				 *  through io_uring, so write it by hand and
+				 *  stop using io_uring
+				 */
+				uring = 0;
+				res = 0;
+			}
+			finish_write(name, fd, &gen.slots[data], res);
+			left--;
+		}
+#endif
+	}
+	for(i=0;i<threads;i++)
+		pthread_join(tids[i], NULL);
+
+	/* cut off the padding, and mark the trace complete */
+	hdr->complete = 1;
+	if((ftruncate(fd, TRACE_HDRSIZE + gen.bytes) < 0) ||
+		(write_all(fd, hdr, TRACE_HDRSIZE, 0) < 0) || (fsync(fd) < 0))
+	{
+		perror(name);
+		ret = -1;
+	}
+	else
+	{
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		secs = elapsed(&start, &now);
+		fprintf(stderr, "%s: wrote %lu bytes in %.2f s, %.1f MB/s, "
+			"%.3g moves/s\n", name, (unsigned long)done, secs,
+			secs ? done / secs / 1e6 : 0.0,
+			secs ? 2.0 * done / secs : 0.0);
+	}
+
+#ifdef HAVE_URING
+	ring_exit();
+#endif
+	close(fd);
+	for(i=0;i<gen.nslots;i++)
+		free(gen.slots[i].buf);
+	free(gen.slots);
+	free(tids);
+	free(hdr);
+	return(ret);
+}
@@ -0,0 +1,51 @@
+/*
+ * Name:	trace.h
+ *
+ * Purpose:     This is the header file for trace.c, which writes the
+ *		complete list of moves for a number of disks to a file,
+ *		without the display. A 40 disk trace is about 10^12 moves,
+ *		so the file is far bigger than memory and the writing has
+ *		to keep up with the generating.
+ *
+ *		The file starts with a TRACE_HDRSIZE byte header (see
+ *		trace_header below), and then has one 4 bit code for each
+ *		move, two to a byte. Move 1 is in the low half of the first
+ *		byte, move 2 in the high half, and so on. Each code is the
+ *		tower the disk came from times 4, plus the tower it went to.
+ *		The disk moved isn't stored, since for move m it is always
+ *		one more than the number of trailing zero bits in m.
+ *
+ * History:	10-19-26	Creation
+ *
+ */
+
+#include <stdint.h>
+
+#define	TRACE_MAGIC	"HANOITRC"	/* first 8 bytes of a trace file */
+#define	TRACE_VERSION	1
+#define	TRACE_HDRSIZE	4096		/* header, padded for O_DIRECT	*/
+#define	TRACE_ALIGN	4096		/* O_DIRECT buffer and size alignment */
+#define	TRACE_CHUNK	(4<<20)		/* bytes in each buffer		*/
+#define	TRACE_BUFS	2		/* buffers for each generator thread */
+#define	TRACE_DEFTHREADS 2		/* default generator threads	*/
+
+/* the header at the start of a trace file */
+typedef struct trace_header {
+	char	magic[8];	/* TRACE_MAGIC				*/
+	uint32_t version;	/* TRACE_VERSION			*/
+	uint32_t disks;		/* number of disks			*/
+	uint64_t moves;		/* number of moves, 2^disks - 1		*/
+	uint64_t bytes;		/* bytes of move codes after the header	*/
+	uint32_t chunk;		/* bytes written at a time		*/
+	uint32_t depth;		/* most chunks in flight at once	*/
+	uint32_t complete;	/* set once every chunk is written	*/
+} trace_header;
+
+/*  write_trace() writes the trace for disks disks to the file name,
+ *  using threads generator threads. If resume is set and name is a
+ *  partly written trace for the same number of disks, it carries on
+ *  from where that one stopped. Progress and the sustained rate are
+ *  reported on stderr. Returns 0 on success, -1 on failure.
+ */
+
+int write_trace(const char *name, int disks, int threads, int resume);